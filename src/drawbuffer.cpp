@@ -1,57 +1,191 @@
 #include "drawbuffer.h"
 #include <glad.h>
+#include <glm/packing.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/common.hpp>
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace {
+	void setDefaultVertexAttrib(GLuint vao, GLuint attrib, GLuint binding, GLuint offset) {
+		glEnableVertexArrayAttrib(vao, attrib);
+		glVertexArrayAttribFormat(vao, attrib, 4, GL_FLOAT, GL_FALSE, offset);
+		glVertexArrayAttribBinding(vao, attrib, binding);
+	}
+
+	struct PackedLayout3D {
+		GLsizei stride;
+		GLuint normalOffset;
+		GLuint colorOffset;
+	};
+
+	PackedLayout3D getPackedLayout3D(eVertexFormat3D format, bool hasNormals, bool hasColors) {
+		assert(format != eVertexFormat3D::Float);
+		PackedLayout3D layout;
+		// half positions are padded to 8 bytes to keep the next attributes 4 bytes aligned
+		const GLuint positionSize = format == eVertexFormat3D::PackedHalf ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+		layout.normalOffset = positionSize;
+		layout.colorOffset = positionSize + (hasNormals ? sizeof(uint32_t) : 0);
+		layout.stride = GLsizei(layout.colorOffset + (hasColors ? sizeof(uint32_t) : 0));
+		return layout;
+	}
+
+	void packVertices3D(char* pPacked, const PackedLayout3D& layout, eVertexFormat3D format, glm::vec3 const* pVertices, glm::vec3 const* pNormals, glm::vec4 const* pColors, GLsizei vertexCount) {
+		for (GLsizei i = 0; i < vertexCount; ++i) {
+			char* pVertex = pPacked + i * layout.stride;
+			if (format == eVertexFormat3D::PackedHalf) {
+				const uint16_t position[4] = {
+					glm::packHalf1x16(pVertices[i].x),
+					glm::packHalf1x16(pVertices[i].y),
+					glm::packHalf1x16(pVertices[i].z),
+					0,
+				};
+				memcpy(pVertex, position, sizeof(position));
+			}
+			else {
+				memcpy(pVertex, &pVertices[i], sizeof(glm::vec3));
+			}
+			if (pNormals) {
+				const uint32_t normal = packVertexNormal(pNormals[i]);
+				memcpy(pVertex + layout.normalOffset, &normal, sizeof(normal));
+			}
+			if (pColors) {
+				const uint32_t color = packVertexColor(pColors[i]);
+				memcpy(pVertex + layout.colorOffset, &color, sizeof(color));
+			}
+		}
+	}
+
+	// orphans the storage when the whole buffer is rewritten so that draws still using it do not stall the upload
+	void uploadRange(GLuint vbo, GLintptr offset, GLsizeiptr size, GLsizeiptr bufferSize, const void* pData) {
+		if (offset == 0 && size == bufferSize) {
+			glInvalidateBufferData(vbo);
+		}
+		glNamedBufferSubData(vbo, offset, size, pData);
+	}
+
+	// attributes of buffer on vao, using bindings 0 to BufferAttribCount - 1
+	void setupVertexArray3D(GLuint vao, const Buffer3D& buffer) {
+		if (buffer.format == eVertexFormat3D::Float) {
+			glVertexArrayVertexBuffer(vao, Buffer3D::BufferAttribVertex, buffer.vbos[Buffer3D::BufferAttribVertex], 0, sizeof(glm::vec3));
+			glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribVertex);
+			glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribVertex, 3, GL_FLOAT, GL_FALSE, 0);
+			glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribVertex, Buffer3D::BufferAttribVertex);
+
+			if (buffer.hasNormals) {
+				glVertexArrayVertexBuffer(vao, Buffer3D::BufferAttribNormal, buffer.vbos[Buffer3D::BufferAttribNormal], 0, sizeof(glm::vec3));
+				glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribNormal);
+				glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribNormal, 3, GL_FLOAT, GL_FALSE, 0);
+				glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribNormal, Buffer3D::BufferAttribNormal);
+			}
+
+			if (buffer.hasColors) {
+				glVertexArrayVertexBuffer(vao, Buffer3D::BufferAttribColor, buffer.vbos[Buffer3D::BufferAttribColor], 0, sizeof(glm::vec4));
+				glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribColor);
+				glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribColor, 4, GL_FLOAT, GL_FALSE, 0);
+				glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribColor, Buffer3D::BufferAttribColor);
+			}
+		}
+		else {
+			// normalized integer attributes reach the shaders as floats, the shaders are the same for every format
+			const PackedLayout3D layout = getPackedLayout3D(buffer.format, buffer.hasNormals, buffer.hasColors);
+			constexpr GLuint binding = Buffer3D::BufferAttribVertex;
+			glVertexArrayVertexBuffer(vao, binding, buffer.vbos[Buffer3D::BufferAttribVertex], 0, layout.stride);
+
+			glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribVertex);
+			if (buffer.format == eVertexFormat3D::PackedHalf) {
+				glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribVertex, 3, GL_HALF_FLOAT, GL_FALSE, 0);
+			}
+			else {
+				glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribVertex, 3, GL_FLOAT, GL_FALSE, 0);
+			}
+			glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribVertex, binding);
+
+			if (buffer.hasNormals) {
+				glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribNormal);
+				glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribNormal, 4, GL_INT_2_10_10_10_REV, GL_TRUE, layout.normalOffset);
+				glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribNormal, binding);
+			}
+
+			if (buffer.hasColors) {
+				glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribColor);
+				glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, layout.colorOffset);
+				glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribColor, binding);
+			}
+		}
+
+		setDefaultVertexAttribs3D(vao, buffer.defaultVertexBuffer, buffer.hasNormals, buffer.hasColors);
+
+		if (buffer.ibo) {
+			glVertexArrayElementBuffer(vao, buffer.ibo);
+		}
+	}
+
+	void growBounds(Buffer3D& buffer, glm::vec3 const* pVertices, GLsizei vertexCount) {
+		for (GLsizei i = 0; i < vertexCount; ++i) {
+			buffer.boundsMin = glm::min(buffer.boundsMin, pVertices[i]);
+			buffer.boundsMax = glm::max(buffer.boundsMax, pVertices[i]);
+		}
+	}
+}
+
+uint32_t packVertexColor(const glm::vec4& color) {
+	return glm::packUnorm4x8(color);
+}
+
+uint32_t packVertexNormal(const glm::vec3& normal) {
+	return glm::packSnorm3x10_1x2(glm::vec4(normal, 0.f));
+}
 
 void createBuffer3D(Buffer3D& buffer, const CreateBuffer3DParams& params) {
 	assert(buffer.vao == 0); // trying to create a buffer already initialized
+	assert(buffer.vbos[Buffer3D::BufferAttribVertex] == 0); // trying to create a buffer already initialized
+	assert(params.defaultVertexBuffer); // see createDefaultVertexBuffer3D
+
+	buffer.format = params.format;
+	buffer.defaultVertexBuffer = params.defaultVertexBuffer;
+	buffer.hasNormals = params.pNormals != nullptr;
+	buffer.hasColors = params.pColors != nullptr;
 
-	glGenVertexArrays(1, &buffer.vao);
+	if (params.vertexCount > 0) {
+		buffer.boundsMin = params.pVertices[0];
+		buffer.boundsMax = params.pVertices[0];
+		growBounds(buffer, params.pVertices, params.vertexCount);
+	}
 
-	glBindVertexArray(buffer.vao);
+	const GLenum usage = params.dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+	if (params.format == eVertexFormat3D::Float) {
+		// Upload vertices, normals and colors in their own buffers
+		glCreateBuffers(1, &buffer.vbos[Buffer3D::BufferAttribVertex]);
+		glNamedBufferData(buffer.vbos[Buffer3D::BufferAttribVertex], params.vertexCount * sizeof(*params.pVertices), params.pVertices, usage);
 
-	// Bind vertices and upload data
-	assert(buffer.vbos[Buffer3D::BufferAttribVertex] == 0); // trying to create a buffer already initialized
-	glGenBuffers(1, &buffer.vbos[Buffer3D::BufferAttribVertex]);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer.vbos[Buffer3D::BufferAttribVertex]);
-	glEnableVertexAttribArray(0);
-	{
-		constexpr size_t size = sizeof(*params.pVertices) / sizeof((*params.pVertices)[0]);
-		constexpr size_t stride = sizeof(*params.pVertices);
-		glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE, stride, (void*)0);
-	}
-	glBufferData(GL_ARRAY_BUFFER, params.vertexCount * sizeof(*params.pVertices), params.pVertices, GL_STATIC_DRAW);
-
-	assert(buffer.vbos[Buffer3D::BufferAttribNormal] == 0); // trying to create a buffer already initialized
-	if(params.pNormals) {
-		glGenBuffers(1, &buffer.vbos[Buffer3D::BufferAttribNormal]);
-		// Bind normals and upload data
-		glBindBuffer(GL_ARRAY_BUFFER, buffer.vbos[buffer.BufferAttribNormal]);
-		glEnableVertexAttribArray(1);
-		{
-			constexpr size_t size = sizeof(*params.pNormals) / sizeof((*params.pNormals)[0]);
-			constexpr size_t stride = sizeof(*params.pNormals);
-			glVertexAttribPointer(1, size, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		if (params.pNormals) {
+			glCreateBuffers(1, &buffer.vbos[Buffer3D::BufferAttribNormal]);
+			glNamedBufferData(buffer.vbos[Buffer3D::BufferAttribNormal], params.vertexCount * sizeof(*params.pNormals), params.pNormals, usage);
+		}
+
+		if (params.pColors) {
+			glCreateBuffers(1, &buffer.vbos[Buffer3D::BufferAttribColor]);
+			glNamedBufferData(buffer.vbos[Buffer3D::BufferAttribColor], params.vertexCount * sizeof(*params.pColors), params.pColors, usage);
 		}
-		glBufferData(GL_ARRAY_BUFFER, params.vertexCount * sizeof(*params.pNormals), params.pNormals, GL_STATIC_DRAW);
-	} else {
-		buffer.vbos[Buffer3D::BufferAttribNormal] = 0;
 	}
+	else {
+		// Pack and interleave every attribute in a single buffer
+		const PackedLayout3D layout = getPackedLayout3D(params.format, buffer.hasNormals, buffer.hasColors);
+		char* pPacked = new char[params.vertexCount * layout.stride];
+		packVertices3D(pPacked, layout, params.format, params.pVertices, params.pNormals, params.pColors, params.vertexCount);
 
-	// Bind colors and upload data
-	assert(buffer.vbos[Buffer3D::BufferAttribColor] == 0); // trying to create a buffer already initialized
-	glGenBuffers(1, &buffer.vbos[Buffer3D::BufferAttribColor]);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer.vbos[buffer.BufferAttribColor]);
-	glEnableVertexAttribArray(2);
-	{
-		constexpr size_t size = sizeof(*params.pColors) / sizeof((*params.pColors)[0]);
-		constexpr size_t stride = sizeof(*params.pColors);
-		glVertexAttribPointer(2, size, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		glCreateBuffers(1, &buffer.vbos[Buffer3D::BufferAttribVertex]);
+		glNamedBufferData(buffer.vbos[Buffer3D::BufferAttribVertex], params.vertexCount * layout.stride, pPacked, usage);
+
+		delete[] pPacked;
 	}
-	glBufferData(GL_ARRAY_BUFFER, params.vertexCount * sizeof(*params.pColors), params.pColors, GL_STATIC_DRAW);
 
 	if(params.pIndices) {
-		glGenBuffers(1, &buffer.ibo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(*params.pIndices) * params.indexCount, params.pIndices, GL_STATIC_DRAW);
+		glCreateBuffers(1, &buffer.ibo);
+		glNamedBufferData(buffer.ibo, sizeof(*params.pIndices) * params.indexCount, params.pIndices, GL_STATIC_DRAW);
 	} else {
 		buffer.ibo = 0;
 		buffer.indexCount = 0;
@@ -60,10 +194,9 @@ void createBuffer3D(Buffer3D& buffer, const CreateBuffer3DParams& params) {
 	buffer.vertexCount = params.vertexCount;
 	buffer.indexCount = params.indexCount;
 
-	// Unbind everything. Potentially illegal on some implementations
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// created with direct state access: the current bindings are left untouched
+	glCreateVertexArrays(1, &buffer.vao);
+	setupVertexArray3D(buffer.vao, buffer);
 }
 
 void deleteBuffer3D(Buffer3D& buffer) {
@@ -74,38 +207,132 @@ void deleteBuffer3D(Buffer3D& buffer) {
 	buffer.vao = 0;
 }
 
-void createBuffer2D(Buffer2D& buffer, const CreateBuffer2DParams& params) {
-	glGenVertexArrays(1, &buffer.vao);
-	glGenBuffers(buffer.BufferAttribCount, buffer.vbos);
+void updateBuffer3D(Buffer3D& buffer, const UpdateBuffer3DParams& params) {
+	assert(buffer.vao); // did you call createBuffer3D ?
+	assert(params.firstVertex >= 0 && params.firstVertex + params.vertexCount <= buffer.vertexCount);
+	assert(!params.pNormals || buffer.hasNormals);
+	assert(!params.pColors || buffer.hasColors);
+	if (params.vertexCount == 0) {
+		return;
+	}
 
-	glBindVertexArray(buffer.vao);
+	if (params.pVertices) {
+		growBounds(buffer, params.pVertices, params.vertexCount);
+	}
 
-	// Bind vertices and upload data
-	glBindBuffer(GL_ARRAY_BUFFER, buffer.vbos[buffer.BufferAttribVertex]);
-	glEnableVertexAttribArray(0);
-	{
-		constexpr size_t size = sizeof(*params.pVertices) / sizeof((*params.pVertices)[0]);
-		constexpr size_t stride = sizeof(*params.pVertices);
-		glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	if (buffer.format == eVertexFormat3D::Float) {
+		if (params.pVertices) {
+			uploadRange(buffer.vbos[Buffer3D::BufferAttribVertex], params.firstVertex * sizeof(glm::vec3), params.vertexCount * sizeof(glm::vec3), buffer.vertexCount * sizeof(glm::vec3), params.pVertices);
+		}
+		if (params.pNormals) {
+			uploadRange(buffer.vbos[Buffer3D::BufferAttribNormal], params.firstVertex * sizeof(glm::vec3), params.vertexCount * sizeof(glm::vec3), buffer.vertexCount * sizeof(glm::vec3), params.pNormals);
+		}
+		if (params.pColors) {
+			uploadRange(buffer.vbos[Buffer3D::BufferAttribColor], params.firstVertex * sizeof(glm::vec4), params.vertexCount * sizeof(glm::vec4), buffer.vertexCount * sizeof(glm::vec4), params.pColors);
+		}
 	}
-	glBufferData(GL_ARRAY_BUFFER, params.vertexCount * sizeof(*params.pVertices), params.pVertices, GL_STATIC_DRAW);
+	else {
+		// interleaved vertices are rewritten as a whole
+		assert(params.pVertices && (params.pNormals != nullptr) == buffer.hasNormals && (params.pColors != nullptr) == buffer.hasColors);
+		const PackedLayout3D layout = getPackedLayout3D(buffer.format, buffer.hasNormals, buffer.hasColors);
+		char* pPacked = new char[params.vertexCount * layout.stride];
+		packVertices3D(pPacked, layout, buffer.format, params.pVertices, params.pNormals, params.pColors, params.vertexCount);
+
+		uploadRange(buffer.vbos[Buffer3D::BufferAttribVertex], params.firstVertex * layout.stride, params.vertexCount * layout.stride, buffer.vertexCount * layout.stride, pPacked);
 
-	// Bind colors and upload data
-	glBindBuffer(GL_ARRAY_BUFFER, buffer.vbos[buffer.BufferAttribColor]);
-	glEnableVertexAttribArray(1);
-	{
-		constexpr size_t size = sizeof(*params.pColors) / sizeof((*params.pColors)[0]);
-		constexpr size_t stride = sizeof(*params.pColors);
-		glVertexAttribPointer(1, size, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		delete[] pPacked;
 	}
-	glBufferData(GL_ARRAY_BUFFER, params.vertexCount * sizeof(*params.pColors), params.pColors, GL_STATIC_DRAW);
+}
 
-	buffer.vertexCount = params.vertexCount;
+void createInstancedVertexArray3D(GLuint& vao, const Buffer3D& buffer, GLuint instanceBuffer) {
+	assert(buffer.vao); // did you call createBuffer3D ?
+
+	glCreateVertexArrays(1, &vao);
+
+	// same vertex layout as createBuffer3D
+	setupVertexArray3D(vao, buffer);
+
+	// one InstanceData3D per instance, draws select their instances with base instance
+	// the instance attributes no longer read the default vertex
+	constexpr GLuint instanceBinding = Buffer3D::BufferAttribInstanceRotation;
+	glVertexArrayVertexBuffer(vao, instanceBinding, instanceBuffer, 0, sizeof(InstanceData3D));
+	glVertexArrayBindingDivisor(vao, instanceBinding, 1);
+
+	glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribInstanceRotation);
+	glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribInstanceRotation, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData3D, rotation));
+	glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribInstanceRotation, instanceBinding);
+
+	glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribInstancePositionScale);
+	glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribInstancePositionScale, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData3D, positionScale));
+	glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribInstancePositionScale, instanceBinding);
 
-	// Unbind everything. Potentially illegal on some implementations
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribInstanceColor);
+	glVertexArrayAttribFormat(vao, Buffer3D::BufferAttribInstanceColor, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData3D, color));
+	glVertexArrayAttribBinding(vao, Buffer3D::BufferAttribInstanceColor, instanceBinding);
+}
+
+void createDefaultVertexBuffer3D(GLuint& buffer) {
+	DefaultVertex3D vertex;
+	vertex.normal = glm::vec4(0.f);
+	vertex.color = glm::vec4(1.f);
+	vertex.instance.rotation = glm::vec4(0.f, 0.f, 0.f, 1.f);
+	vertex.instance.positionScale = glm::vec4(0.f, 0.f, 0.f, 1.f);
+	vertex.instance.color = glm::vec4(1.f);
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, sizeof(vertex), &vertex, 0);
+}
+
+void deleteDefaultVertexBuffer3D(GLuint& buffer) {
+	// the vertex arrays still using it keep its storage alive
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void setDefaultVertexAttribs3D(GLuint vao, GLuint defaultVertexBuffer, bool hasNormals, bool hasColors) {
+	assert(defaultVertexBuffer); // see createDefaultVertexBuffer3D
+	// a stride of 0 reads the same vertex for every vertex and every instance
+	constexpr GLuint binding = Buffer3D::BufferBindingDefaults;
+	glVertexArrayVertexBuffer(vao, binding, defaultVertexBuffer, 0, 0);
+	if (!hasNormals) {
+		setDefaultVertexAttrib(vao, Buffer3D::BufferAttribNormal, binding, offsetof(DefaultVertex3D, normal));
+	}
+	if (!hasColors) {
+		setDefaultVertexAttrib(vao, Buffer3D::BufferAttribColor, binding, offsetof(DefaultVertex3D, color));
+	}
+	setDefaultVertexAttrib(vao, Buffer3D::BufferAttribInstanceRotation, binding, offsetof(DefaultVertex3D, instance.rotation));
+	setDefaultVertexAttrib(vao, Buffer3D::BufferAttribInstancePositionScale, binding, offsetof(DefaultVertex3D, instance.positionScale));
+	setDefaultVertexAttrib(vao, Buffer3D::BufferAttribInstanceColor, binding, offsetof(DefaultVertex3D, instance.color));
+}
+
+void createBuffer2D(Buffer2D& buffer, const CreateBuffer2DParams& params) {
+	// created with direct state access: the current bindings are left untouched
+	glCreateVertexArrays(1, &buffer.vao);
+
+	// Upload vertices
+	glCreateBuffers(1, &buffer.vbos[buffer.BufferAttribVertex]);
+	glNamedBufferData(buffer.vbos[buffer.BufferAttribVertex], params.vertexCount * sizeof(*params.pVertices), params.pVertices, GL_STATIC_DRAW);
+	glVertexArrayVertexBuffer(buffer.vao, buffer.BufferAttribVertex, buffer.vbos[buffer.BufferAttribVertex], 0, sizeof(*params.pVertices));
+	glEnableVertexArrayAttrib(buffer.vao, buffer.BufferAttribVertex);
+	glVertexArrayAttribFormat(buffer.vao, buffer.BufferAttribVertex, 2, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(buffer.vao, buffer.BufferAttribVertex, buffer.BufferAttribVertex);
+
+	// Upload colors
+	if (params.pColors) {
+		glCreateBuffers(1, &buffer.vbos[buffer.BufferAttribColor]);
+		glNamedBufferData(buffer.vbos[buffer.BufferAttribColor], params.vertexCount * sizeof(*params.pColors), params.pColors, GL_STATIC_DRAW);
+		glVertexArrayVertexBuffer(buffer.vao, buffer.BufferAttribColor, buffer.vbos[buffer.BufferAttribColor], 0, sizeof(*params.pColors));
+		glEnableVertexArrayAttrib(buffer.vao, buffer.BufferAttribColor);
+		glVertexArrayAttribFormat(buffer.vao, buffer.BufferAttribColor, 4, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(buffer.vao, buffer.BufferAttribColor, buffer.BufferAttribColor);
+	}
+	else {
+		assert(params.defaultVertexBuffer); // see createDefaultVertexBuffer3D
+		glVertexArrayVertexBuffer(buffer.vao, Buffer2D::BufferBindingDefaults, params.defaultVertexBuffer, 0, 0);
+		setDefaultVertexAttrib(buffer.vao, Buffer2D::BufferAttribColor, Buffer2D::BufferBindingDefaults, offsetof(DefaultVertex3D, color));
+	}
+
+	buffer.vertexCount = params.vertexCount;
+	buffer.hasColors = params.pColors != nullptr;
 }
 
 void deleteBuffer2D(Buffer2D& buffer) {
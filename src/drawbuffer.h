@@ -5,6 +5,20 @@
 #include <glm/vec4.hpp>
 #include <glad.h>
 
+#include <stdint.h>
+
+enum class eVertexFormat3D {
+	Float = 0,			// one float array per attribute
+	Packed,				// interleaved: float position, 2_10_10_10 normal, RGBA8 color
+	PackedHalf,			// same with half float positions, for meshes with small coordinates (unit meshes)
+};
+
+// RGBA8 unorm, as read by packed vertex formats
+uint32_t packVertexColor(const glm::vec4& color);
+
+// 2_10_10_10 snorm, as read by packed vertex formats
+uint32_t packVertexNormal(const glm::vec3& normal);
+
 struct Buffer3D {
 	enum {
 		BufferAttribVertex = 0,
@@ -12,41 +26,104 @@ struct Buffer3D {
 		BufferAttribColor,
 		BufferAttribCount
 	};
+	// per-instance attributes, sourced from an InstanceData3D buffer by instanced vertex arrays
+	enum {
+		BufferAttribInstanceRotation = BufferAttribCount,
+		BufferAttribInstancePositionScale,
+		BufferAttribInstanceColor,
+	};
+	// binding of the default attributes in the vertex arrays, see setDefaultVertexAttribs3D
+	enum {
+		BufferBindingDefaults = BufferAttribInstanceColor + 1
+	};
 	GLuint vao = 0;
-	GLuint vbos[BufferAttribCount] = {};
+	GLuint vbos[BufferAttribCount] = {};	// packed formats only use vbos[BufferAttribVertex]
 	GLuint ibo = 0;
 	GLsizei vertexCount = 0;
 	GLsizei indexCount = 0;
+	eVertexFormat3D format = eVertexFormat3D::Float;
+	bool hasNormals = false;
+	bool hasColors = false;		// otherwise the color attribute reads the default vertex (white)
+	GLuint defaultVertexBuffer = 0;		// not owned, also read by the instanced vertex arrays of the buffer
+	// object space box of the positions, used for culling. updates only grow it
+	glm::vec3 boundsMin = glm::vec3(0.f);
+	glm::vec3 boundsMax = glm::vec3(0.f);
 };
 
 struct CreateBuffer3DParams {
 	glm::vec3 const* pVertices = nullptr;
 	glm::vec3 const* pNormals = nullptr;
-	glm::vec4 const* pColors = nullptr;
+	glm::vec4 const* pColors = nullptr;		// optional, leave null for meshes of a single color given at draw time
 	unsigned int const* pIndices = nullptr;
 	GLsizei vertexCount = 0;
 	GLsizei indexCount = 0;
+	eVertexFormat3D format = eVertexFormat3D::Float;	// inputs are always floats, packed formats are converted at upload
+	bool dynamic = false;	// updated after creation with updateBuffer3D
+	GLuint defaultVertexBuffer = 0;		// RenderEngine::defaultVertexBuffer3D, must outlive the buffer
 };
 
 void createBuffer3D(Buffer3D& buffer, const CreateBuffer3DParams& params);
 
 void deleteBuffer3D(Buffer3D& buffer);
 
+// vertices [firstVertex, firstVertex + vertexCount) of the given attributes, null attributes are left unchanged
+// packed formats are interleaved: every attribute of the buffer must be given
+struct UpdateBuffer3DParams {
+	glm::vec3 const* pVertices = nullptr;
+	glm::vec3 const* pNormals = nullptr;
+	glm::vec4 const* pColors = nullptr;
+	GLsizei firstVertex = 0;
+	GLsizei vertexCount = 0;
+};
+
+void updateBuffer3D(Buffer3D& buffer, const UpdateBuffer3DParams& params);
+
+// vertex transformed as rotation * (position * scale) + position, color multiplies the vertex color
+struct InstanceData3D {
+	glm::vec4 rotation;			// quaternion xyzw
+	glm::vec4 positionScale;	// position xyz, uniform scale w
+	glm::vec4 color;
+};
+
+// vertex array sourcing vertices from buffer and per-instance attributes from instanceBuffer
+void createInstancedVertexArray3D(GLuint& vao, const Buffer3D& buffer, GLuint instanceBuffer);
+
+// values of the attributes a 3D vertex array does not read from its vertices or instances
+struct DefaultVertex3D {
+	glm::vec4 normal;			// zero
+	glm::vec4 color;			// white, the draw color multiplies it
+	InstanceData3D instance;	// identity rotation, no offset, scale 1 and white
+};
+
+// buffer holding one DefaultVertex3D, owned by the render engine and shared by its vertex arrays
+void createDefaultVertexBuffer3D(GLuint& buffer);
+void deleteDefaultVertexBuffer3D(GLuint& buffer);
+
+// the normal and color attributes the vertices do not have and the instance attributes of vao read the default vertex,
+// every vertex reads the same one. the vertex arrays do not depend on the current values of the context
+void setDefaultVertexAttribs3D(GLuint vao, GLuint defaultVertexBuffer, bool hasNormals, bool hasColors);
+
 struct Buffer2D {
 	enum {
 		BufferAttribVertex = 0,
 		BufferAttribColor,
 		BufferAttribCount
 	};
+	// binding of the default color
+	enum {
+		BufferBindingDefaults = BufferAttribCount
+	};
 	GLuint vao = 0;
 	GLuint vbos[BufferAttribCount] = {};
 	GLsizei vertexCount = 0;
+	bool hasColors = false;		// otherwise the color attribute reads the white of the default vertex
 };
 
 struct CreateBuffer2DParams {
 	glm::vec2 const* pVertices = nullptr;
-	glm::vec4 const* pColors = nullptr;
+	glm::vec4 const* pColors = nullptr;		// optional, white otherwise. the draw color multiplies the colors
 	GLsizei vertexCount = 0;
+	GLuint defaultVertexBuffer = 0;		// RenderEngine::defaultVertexBuffer3D without colors, must outlive the buffer
 };
 
 void createBuffer2D(Buffer2D& buffer, const CreateBuffer2DParams& params);
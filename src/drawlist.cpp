@@ -0,0 +1,313 @@
+#include "drawlist.h"
+#include "shader.h"
+#include "glstate.h"
+#include "streambuffer.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+	constexpr uint32_t DrawDataBaseName = hashShaderName("DrawDataBase");
+	constexpr uint32_t LightingEnabledName = hashShaderName("LightingEnabled");
+
+	// solid geometry first so that lines and points lying on it win the depth test, as in submission order
+	unsigned int drawModeSortIndex(GLenum drawMode) {
+		switch (drawMode) {
+		case GL_TRIANGLES:
+			return 0;
+		case GL_LINES:
+			return 1;
+		case GL_LINE_STRIP:
+			return 2;
+		default:
+			return 3;
+		}
+	}
+
+	uint64_t makeStateKey(const DrawCommand3D& command) {
+		return (uint64_t(command.programIndex) << 36)
+			| (uint64_t(drawModeSortIndex(command.drawMode)) << 34)
+			| (uint64_t(command.lightingEnabled) << 33)
+			| (uint64_t(command.indexed) << 32)
+			| uint64_t(command.vao);
+	}
+
+	// the indirect commands of a run start at runBegin, DrawDataBase + gl_DrawID selects the draw data
+	void executeRun(DrawList3D& list, ShaderProgram& shader, const DrawCommand3D& command, GLintptr indirectOffset, GLsizei runBegin, GLsizei runCount) {
+		const GLsizei stride = sizeof(DrawElementsIndirectCommand);
+		const GLintptr runOffset = indirectOffset + runBegin * stride;
+		if (list.drawIdSupported) {
+			setShaderParameter(shader, DrawDataBaseName, runBegin);
+			if (command.indexed) {
+				glMultiDrawElementsIndirect(command.drawMode, GL_UNSIGNED_INT, (void const*)runOffset, runCount, stride);
+			}
+			else {
+				glMultiDrawArraysIndirect(command.drawMode, (void const*)runOffset, runCount, stride);
+			}
+			++list.drawCount;
+			return;
+		}
+
+		for (GLsizei iDraw = 0; iDraw < runCount; ++iDraw) {
+			setShaderParameter(shader, DrawDataBaseName, runBegin + iDraw);
+			if (command.indexed) {
+				glDrawElementsIndirect(command.drawMode, GL_UNSIGNED_INT, (void const*)(runOffset + iDraw * stride));
+			}
+			else {
+				glDrawArraysIndirect(command.drawMode, (void const*)(runOffset + iDraw * stride));
+			}
+			++list.drawCount;
+		}
+	}
+
+	// draws the sorted entries [begin, end[, their draw data and indirect commands are written at the same index
+	void executeEntries(DrawList3D& list, GLStateCache& state, DrawData3D* pDrawData, DrawElementsIndirectCommand* pIndirect, GLintptr indirectOffset, size_t begin, size_t end) {
+		size_t iEntry = begin;
+		while (iEntry < end) {
+			const DrawCommand3D& first = list.commands[list.sortEntries[iEntry].orderKey];
+			ShaderProgram& shader = *list.programs[first.programIndex];
+
+			useProgram(state, shader.programId);
+			setShaderParameter(shader, LightingEnabledName, (int)first.lightingEnabled);
+			bindVertexArray(state, first.vao);
+			// strips are separated by the index 0xFFFFFFFF
+			setPrimitiveRestartEnabled(state, first.indexed && first.drawMode == GL_LINE_STRIP);
+
+			const size_t runBegin = iEntry;
+			const uint64_t stateKey = list.sortEntries[iEntry].stateKey;
+			for (; iEntry < end && list.sortEntries[iEntry].stateKey == stateKey; ++iEntry) {
+				const DrawCommand3D& command = list.commands[list.sortEntries[iEntry].orderKey];
+
+				pDrawData[iEntry].model = list.models[command.modelIndex];
+				pDrawData[iEntry].color = command.color;
+
+				// not instanced draws are one instance of the constant instance attributes
+				DrawElementsIndirectCommand& indirect = pIndirect[iEntry];
+				indirect.count = command.count;
+				indirect.instanceCount = command.instanceCount > 0 ? command.instanceCount : 1;
+				if (command.indexed) {
+					indirect.firstIndex = GLuint(command.indexOffset / sizeof(GLuint));
+					indirect.baseVertex = command.firstVertex;
+					indirect.baseInstance = command.baseInstance;
+				}
+				else {
+					// DrawArraysIndirectCommand layout
+					DrawArraysIndirectCommand& arrays = (DrawArraysIndirectCommand&)indirect;
+					arrays.first = command.firstVertex;
+					arrays.baseInstance = command.baseInstance;
+				}
+			}
+
+			executeRun(list, shader, first, indirectOffset, (GLsizei)runBegin, GLsizei(iEntry - runBegin));
+		}
+	}
+}
+
+void beginDrawList3D(DrawList3D& list) {
+	list.programs.clear();
+	list.models.clear();
+	list.models.push_back(glm::mat4(1.f));
+	list.commands.clear();
+	list.commandCount = 0;
+	list.transparentCommandCount = 0;
+	list.drawCount = 0;
+}
+
+void recordDrawCommand3D(DrawList3D& list, GLStateCache& state, StreamBuffer& streamBuffer, ShaderProgram& shader, DrawCommand3D command, glm::mat4 const* pModel) {
+	assert(!list.models.empty()); // did you call beginDrawList3D ?
+
+	unsigned int programIndex = 0;
+	while (programIndex < list.programs.size() && list.programs[programIndex] != &shader) {
+		++programIndex;
+	}
+	if (programIndex == list.programs.size()) {
+		list.programs.push_back(&shader);
+	}
+	command.programIndex = programIndex;
+
+	if (pModel) {
+		command.modelIndex = (unsigned int)list.models.size();
+		list.models.push_back(*pModel);
+	}
+	else {
+		command.modelIndex = 0;
+	}
+
+	list.commands.push_back(command);
+
+	if (!list.deferred) {
+		flushDrawList3D(list, state, streamBuffer);
+	}
+}
+
+void flushDrawList3D(DrawList3D& list, GLStateCache& state, StreamBuffer& streamBuffer, bool keepTransparent) {
+	if (list.commands.empty()) {
+		return;
+	}
+
+	// opaque commands: stable sort on state, then submission order
+	list.sortEntries.clear();
+	list.depthSort.keys.clear();
+	list.depthSort.values.clear();
+	list.keptCommands.clear();
+	for (size_t iCommand = 0; iCommand < list.commands.size(); ++iCommand) {
+		const DrawCommand3D& command = list.commands[iCommand];
+		if (!command.transparent) {
+			list.sortEntries.push_back({ makeStateKey(command), uint64_t(iCommand) });
+		}
+		else if (keepTransparent) {
+			list.keptCommands.push_back(command);
+		}
+		else {
+			list.depthSort.keys.push_back(~getRadixKey(command.depth));
+			list.depthSort.values.push_back(uint32_t(iCommand));
+		}
+	}
+	std::sort(list.sortEntries.begin(), list.sortEntries.end(), [](const DrawList3D::SortEntry& a, const DrawList3D::SortEntry& b) {
+		return a.stateKey != b.stateKey ? a.stateKey < b.stateKey : a.orderKey < b.orderKey;
+	});
+	const size_t opaqueCount = list.sortEntries.size();
+
+	// transparent commands: far to near, consecutive commands sharing the same state still make one run
+	radixSort(list.depthSort);
+	for (uint32_t iCommand : list.depthSort.values) {
+		list.sortEntries.push_back({ makeStateKey(list.commands[iCommand]), uint64_t(iCommand) });
+	}
+	const size_t commandCount = list.sortEntries.size();
+	list.commandCount += (unsigned int)commandCount;
+	list.transparentCommandCount += (unsigned int)(commandCount - opaqueCount);
+
+	// one draw data and one indirect command per command, in sorted order.
+	// arrays commands use the stride of elements commands so that both share the same indexing
+	GLintptr drawDataOffset;
+	GLintptr indirectOffset;
+	DrawData3D* pDrawData = commandCount ? (DrawData3D*)allocateStreamBuffer(streamBuffer, commandCount * sizeof(DrawData3D), list.storageBufferAlignment, drawDataOffset) : nullptr;
+	DrawElementsIndirectCommand* pIndirect = pDrawData ? (DrawElementsIndirectCommand*)allocateStreamBuffer(streamBuffer, commandCount * sizeof(DrawElementsIndirectCommand), sizeof(GLuint), indirectOffset) : nullptr;
+	if (pIndirect) {
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DrawData3D::Binding, streamBuffer.bufferId, drawDataOffset, commandCount * sizeof(DrawData3D));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, streamBuffer.bufferId);
+
+		executeEntries(list, state, pDrawData, pIndirect, indirectOffset, 0, opaqueCount);
+		if (opaqueCount < commandCount) {
+			// blended over the opaque draws, they don't hide each other
+			setDepthWriteEnabled(state, false);
+			executeEntries(list, state, pDrawData, pIndirect, indirectOffset, opaqueCount, commandCount);
+			setDepthWriteEnabled(state, true);
+		}
+		setPrimitiveRestartEnabled(state, false);
+	}
+	else if (commandCount) {
+		fprintf(stderr, "Stream buffer is full, %d 3D draws skipped\n", (int)commandCount);
+	}
+
+	list.commands.swap(list.keptCommands);
+	list.keptCommands.clear();
+}
+
+void beginDrawList2D(DrawList2D& list) {
+	list.triangles.clear();
+	list.lines.clear();
+	list.stripVertices.clear();
+	list.stripIndices.clear();
+	list.shapes.clear();
+	list.drawCount = 0;
+}
+
+StreamVertex2D* appendTriangles2D(DrawList2D& list, unsigned int vertexCount) {
+	const size_t first = list.triangles.size();
+	list.triangles.resize(first + vertexCount);
+	return list.triangles.data() + first;
+}
+
+StreamVertex2D* appendLines2D(DrawList2D& list, unsigned int vertexCount) {
+	const size_t first = list.lines.size();
+	list.lines.resize(first + vertexCount);
+	return list.lines.data() + first;
+}
+
+StreamShape2D* appendShapes2D(DrawList2D& list, unsigned int shapeCount) {
+	const size_t first = list.shapes.size();
+	list.shapes.resize(first + shapeCount * 6);
+	return list.shapes.data() + first;
+}
+
+StreamVertex2D* appendLineStrip2D(DrawList2D& list, unsigned int vertexCount) {
+	const size_t first = list.stripVertices.size();
+	if (!list.stripIndices.empty()) {
+		list.stripIndices.push_back(0xFFFFFFFF);
+	}
+	for (unsigned int i = 0; i < vertexCount; ++i) {
+		list.stripIndices.push_back(uint32_t(first + i));
+	}
+	list.stripVertices.resize(first + vertexCount);
+	return list.stripVertices.data() + first;
+}
+
+void flushDrawList2D(DrawList2D& list, GLStateCache& state, StreamBuffer& streamBuffer, GLuint program, GLuint vao, GLuint shapeProgram, GLuint shapeVao) {
+	const GLsizei triangleVertexCount = (GLsizei)list.triangles.size();
+	const GLsizei lineVertexCount = (GLsizei)list.lines.size();
+	const GLsizei stripVertexCount = (GLsizei)list.stripVertices.size();
+	const GLsizei stripIndexCount = (GLsizei)list.stripIndices.size();
+	const GLsizei shapeVertexCount = (GLsizei)list.shapes.size();
+
+	const GLsizei vertexCount = triangleVertexCount + lineVertexCount + stripVertexCount;
+	if (vertexCount > 0) {
+		GLintptr offset;
+		GLintptr indexOffset = 0;
+		StreamVertex2D* pVertices = (StreamVertex2D*)allocateStreamBuffer(streamBuffer, vertexCount * sizeof(StreamVertex2D), sizeof(StreamVertex2D), offset);
+		uint32_t* pIndices = pVertices && stripIndexCount > 0 ? (uint32_t*)allocateStreamBuffer(streamBuffer, stripIndexCount * sizeof(uint32_t), sizeof(uint32_t), indexOffset) : nullptr;
+		if (pVertices && (pIndices || stripIndexCount == 0)) {
+			memcpy(pVertices, list.triangles.data(), triangleVertexCount * sizeof(StreamVertex2D));
+			memcpy(pVertices + triangleVertexCount, list.lines.data(), lineVertexCount * sizeof(StreamVertex2D));
+			memcpy(pVertices + triangleVertexCount + lineVertexCount, list.stripVertices.data(), stripVertexCount * sizeof(StreamVertex2D));
+			if (pIndices) {
+				memcpy(pIndices, list.stripIndices.data(), stripIndexCount * sizeof(uint32_t));
+			}
+			const GLint firstVertex = GLint(offset / sizeof(StreamVertex2D));
+
+			useProgram(state, program);
+			bindVertexArray(state, vao);
+			if (triangleVertexCount > 0) {
+				glDrawArrays(GL_TRIANGLES, firstVertex, triangleVertexCount);
+				++list.drawCount;
+			}
+			if (lineVertexCount > 0) {
+				glDrawArrays(GL_LINES, firstVertex + triangleVertexCount, lineVertexCount);
+				++list.drawCount;
+			}
+			if (stripIndexCount > 0) {
+				setPrimitiveRestartEnabled(state, true);
+				glDrawElementsBaseVertex(GL_LINE_STRIP, stripIndexCount, GL_UNSIGNED_INT, (void const*)indexOffset, firstVertex + triangleVertexCount + lineVertexCount);
+				setPrimitiveRestartEnabled(state, false);
+				++list.drawCount;
+			}
+		}
+		else {
+			fprintf(stderr, "Stream buffer is full, 2D overlay skipped\n");
+		}
+	}
+
+	if (shapeVertexCount > 0) {
+		GLintptr offset;
+		StreamShape2D* pVertices = (StreamShape2D*)allocateStreamBuffer(streamBuffer, shapeVertexCount * sizeof(StreamShape2D), sizeof(StreamShape2D), offset);
+		if (pVertices) {
+			memcpy(pVertices, list.shapes.data(), shapeVertexCount * sizeof(StreamShape2D));
+
+			useProgram(state, shapeProgram);
+			bindVertexArray(state, shapeVao);
+			glDrawArrays(GL_TRIANGLES, GLint(offset / sizeof(StreamShape2D)), shapeVertexCount);
+			++list.drawCount;
+		}
+		else {
+			fprintf(stderr, "Stream buffer is full, 2D shapes skipped\n");
+		}
+	}
+
+	list.triangles.clear();
+	list.lines.clear();
+	list.stripVertices.clear();
+	list.stripIndices.clear();
+	list.shapes.clear();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad.h>
+#include "streambuffer.h"
+#include "radixsort.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+struct ShaderProgram;
+struct GLStateCache;
+
+struct DrawCommand3D {
+	GLuint vao = 0;
+	GLenum drawMode = GL_TRIANGLES;
+	GLsizei count = 0;
+	GLint firstVertex = 0;		// first vertex when not indexed, base vertex otherwise
+	GLintptr indexOffset = 0;	// byte offset in the element buffer of the vao, only used when indexed
+	GLsizei instanceCount = 0;		// 0 when not instanced
+	GLuint baseInstance = 0;
+	bool indexed = false;
+	bool lightingEnabled = false;
+	bool transparent = false;	// drawn after the opaque draws, far to near, without depth writes
+	float depth = 0.f;		// view space depth of transparent draws
+	unsigned int programIndex = 0;	// index in DrawList3D::programs
+	unsigned int modelIndex = 0;	// index in DrawList3D::models, 0 is identity
+	glm::vec4 color = glm::vec4(1.f);	// multiplies the vertex colors
+};
+
+// layouts of the indirect buffer commands (GL 4.3)
+struct DrawArraysIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Per-frame list of 3D draws.
+// Opaque commands are sorted by program, draw mode, lighting flag and vao at flush time,
+// transparent commands follow them back to front. Each run of commands sharing the same state is one glMultiDraw*Indirect call.
+// Model matrices and colors are written to a DrawData3D storage buffer indexed by gl_DrawID.
+struct DrawList3D {
+	struct SortEntry {
+		uint64_t stateKey;
+		uint64_t orderKey;
+	};
+
+	std::vector<ShaderProgram*> programs;
+	std::vector<glm::mat4> models;
+	std::vector<DrawCommand3D> commands;
+
+	// scratch memory kept between frames
+	std::vector<SortEntry> sortEntries;
+	RadixSortBuffer depthSort;
+	std::vector<DrawCommand3D> keptCommands;
+
+	// when false, commands are executed as soon as they are recorded
+	bool deferred = true;
+
+	// GL_ARB_shader_draw_parameters, without it each draw of a run is a separate indirect draw
+	bool drawIdSupported = false;
+	GLint storageBufferAlignment = 256;
+
+	// stats of the last flush
+	unsigned int commandCount = 0;
+	unsigned int transparentCommandCount = 0;
+	unsigned int drawCount = 0;
+};
+
+void beginDrawList3D(DrawList3D& list);
+
+// pModel can be null for identity
+// draw data and indirect commands are allocated in the stream buffer
+void recordDrawCommand3D(DrawList3D& list, GLStateCache& state, StreamBuffer& streamBuffer, ShaderProgram& shader, DrawCommand3D command, glm::mat4 const* pModel);
+
+// with keepTransparent the transparent commands stay in the list, to be drawn after the opaque commands of the next passes
+void flushDrawList3D(DrawList3D& list, GLStateCache& state, StreamBuffer& streamBuffer, bool keepTransparent = false);
+
+// Per-frame 2D overlay: shapes are appended as triangles, lines, line strips or analytic shapes and drawn with one draw
+// of each when the list is flushed, in that order.
+struct DrawList2D {
+	std::vector<StreamVertex2D> triangles;
+	std::vector<StreamVertex2D> lines;
+	std::vector<StreamVertex2D> stripVertices;
+	std::vector<uint32_t> stripIndices;		// strips are separated by the primitive restart index
+	std::vector<StreamShape2D> shapes;		// 6 vertices per shape
+
+	// stats of the frame
+	unsigned int drawCount = 0;
+};
+
+void beginDrawList2D(DrawList2D& list);
+
+// returns room for vertexCount vertices, valid until the next append
+StreamVertex2D* appendTriangles2D(DrawList2D& list, unsigned int vertexCount);
+StreamVertex2D* appendLines2D(DrawList2D& list, unsigned int vertexCount);
+StreamShape2D* appendShapes2D(DrawList2D& list, unsigned int shapeCount);
+StreamVertex2D* appendLineStrip2D(DrawList2D& list, unsigned int vertexCount);
+
+// vao and shapeVao source the stream buffer as StreamVertex2D and StreamShape2D, drawn with program and shapeProgram
+void flushDrawList2D(DrawList2D& list, GLStateCache& state, StreamBuffer& streamBuffer, GLuint program, GLuint vao, GLuint shapeProgram, GLuint shapeVao);
@@ -0,0 +1,199 @@
+#include "framecapture.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+	constexpr GLbitfield CaptureBufferFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	bool writeSlot(const FrameCapture& capture, const FrameCapture::Slot& slot) {
+		char path[600];
+		snprintf(path, sizeof(path), "%s_%05u.%s", capture.pathPrefix, slot.frameNumber, capture.format == eCaptureFormat::PPM ? "ppm" : "raw");
+		FILE* pFile = fopen(path, "wb");
+		if (!pFile) {
+			fprintf(stderr, "Failed to open %s\n", path);
+			return false;
+		}
+
+		const size_t rowSize = size_t(slot.width) * 4;
+		if (capture.format == eCaptureFormat::PPM) {
+			fprintf(pFile, "P6\n%d %d\n255\n", slot.width, slot.height);
+			std::vector<unsigned char> row(size_t(slot.width) * 3);
+			for (int y = slot.height - 1; y >= 0; --y) {
+				unsigned char const* pSource = slot.pMappedMemory + y * rowSize;
+				for (int x = 0; x < slot.width; ++x) {
+					row[x * 3 + 0] = pSource[x * 4 + 0];
+					row[x * 3 + 1] = pSource[x * 4 + 1];
+					row[x * 3 + 2] = pSource[x * 4 + 2];
+				}
+				fwrite(row.data(), 1, row.size(), pFile);
+			}
+		}
+		else {
+			fwrite(slot.pMappedMemory, 1, rowSize * slot.height, pFile);
+		}
+		fclose(pFile);
+		return true;
+	}
+
+	void runWorker(FrameCapture& capture) {
+		std::vector<unsigned int> slots;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(capture.mutex);
+				capture.condition.wait(lock, [&capture]() { return capture.stopWorker || !capture.queue.empty(); });
+				if (capture.queue.empty()) {
+					return;
+				}
+				slots.swap(capture.queue);
+			}
+			for (unsigned int iSlot : slots) {
+				FrameCapture::Slot& slot = capture.slots[iSlot];
+				if (writeSlot(capture, slot)) {
+					++capture.writtenFrames;
+				}
+				slot.state = FrameCapture::eSlotState::Free;
+			}
+			slots.clear();
+		}
+	}
+
+	// hands the slots whose readback is done to the worker, in order. with wait, blocks until they all are
+	void submitReadSlots(FrameCapture& capture, bool wait) {
+		bool submitted = false;
+		for (;;) {
+			FrameCapture::Slot& slot = capture.slots[capture.pendingSlot];
+			if (slot.state != FrameCapture::eSlotState::Reading) {
+				break;
+			}
+			const GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+			if (result == GL_TIMEOUT_EXPIRED) {
+				if (wait) {
+					continue;
+				}
+				break;
+			}
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+
+			slot.state = FrameCapture::eSlotState::Writing;
+			{
+				std::lock_guard<std::mutex> lock(capture.mutex);
+				capture.queue.push_back(capture.pendingSlot);
+			}
+			submitted = true;
+			capture.pendingSlot = (capture.pendingSlot + 1) % FrameCapture::SlotCount;
+		}
+		if (submitted) {
+			capture.condition.notify_one();
+		}
+	}
+
+	// (re)creates the buffer of a free slot too small for the frame
+	bool reserveSlot(FrameCapture::Slot& slot, GLsizeiptr size) {
+		if (slot.capacity >= size) {
+			return true;
+		}
+		if (slot.bufferId) {
+			glDeleteBuffers(1, &slot.bufferId);
+		}
+		glCreateBuffers(1, &slot.bufferId);
+		glNamedBufferStorage(slot.bufferId, size, nullptr, CaptureBufferFlags);
+		slot.pMappedMemory = (unsigned char*)glMapNamedBufferRange(slot.bufferId, 0, size, CaptureBufferFlags);
+		if (!slot.pMappedMemory) {
+			fprintf(stderr, "Failed to map capture buffer\n");
+			glDeleteBuffers(1, &slot.bufferId);
+			slot.bufferId = 0;
+			slot.capacity = 0;
+			return false;
+		}
+		slot.capacity = size;
+		return true;
+	}
+}
+
+bool createFrameCapture(FrameCapture& capture, char const* szPathPrefix, eCaptureFormat format) {
+	assert(!capture.worker.joinable()); // did you call deleteFrameCapture ?
+	strncpy(capture.pathPrefix, szPathPrefix, sizeof(capture.pathPrefix) - 1);
+	capture.format = format;
+	capture.writeSlot = 0;
+	capture.pendingSlot = 0;
+	capture.stopWorker = false;
+	capture.stopping = false;
+	capture.capturedFrames = 0;
+	capture.droppedFrames = 0;
+	capture.writtenFrames = 0;
+	capture.worker = std::thread(runWorker, std::ref(capture));
+	return true;
+}
+
+void deleteFrameCapture(FrameCapture& capture) {
+	if (capture.worker.joinable()) {
+		submitReadSlots(capture, true);
+		{
+			std::lock_guard<std::mutex> lock(capture.mutex);
+			capture.stopWorker = true;
+		}
+		capture.condition.notify_one();
+		capture.worker.join();
+	}
+
+	// the worker does not read the mapped memory anymore
+	for (FrameCapture::Slot& slot : capture.slots) {
+		if (slot.bufferId) {
+			glDeleteBuffers(1, &slot.bufferId);
+		}
+		slot.bufferId = 0;
+		slot.pMappedMemory = nullptr;
+		slot.capacity = 0;
+		slot.state = FrameCapture::eSlotState::Free;
+	}
+	capture.queue.clear();
+	capture.stopping = false;
+}
+
+void stopFrameCapture(FrameCapture& capture) {
+	assert(capture.worker.joinable()); // did you call createFrameCapture ?
+	capture.stopping = true;
+}
+
+bool finishFrameCapture(FrameCapture& capture) {
+	assert(capture.stopping); // did you call stopFrameCapture ?
+	submitReadSlots(capture, false);
+	for (const FrameCapture::Slot& slot : capture.slots) {
+		if (slot.state != FrameCapture::eSlotState::Free) {
+			return false;
+		}
+	}
+	// the queue is empty and the worker idle: nothing to wait for
+	deleteFrameCapture(capture);
+	return true;
+}
+
+void captureFrame(FrameCapture& capture, int width, int height) {
+	assert(capture.worker.joinable()); // did you call createFrameCapture ?
+	assert(!capture.stopping);
+	submitReadSlots(capture, false);
+
+	const unsigned int frameNumber = capture.capturedFrames + capture.droppedFrames;
+	FrameCapture::Slot& slot = capture.slots[capture.writeSlot];
+	if (slot.state != FrameCapture::eSlotState::Free || !reserveSlot(slot, GLsizeiptr(width) * height * 4)) {
+		++capture.droppedFrames;
+		return;
+	}
+
+	// the copy to the pixel buffer is asynchronous
+	slot.width = width;
+	slot.height = height;
+	slot.frameNumber = frameNumber;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.bufferId);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.state = FrameCapture::eSlotState::Reading;
+
+	capture.writeSlot = (capture.writeSlot + 1) % FrameCapture::SlotCount;
+	++capture.capturedFrames;
+}
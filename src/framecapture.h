@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class eCaptureFormat {
+	Raw = 0,	// RGBA rows from the bottom, as read by glReadPixels
+	PPM,		// binary RGB rows from the top
+};
+
+// Frames read back with glReadPixels into a ring of persistently mapped pixel buffers.
+// A slot is handed to the worker thread once its fence is signaled, a few frames later, and the worker writes
+// it to disk straight from the mapped memory: the render thread never waits for the GPU nor for the disk.
+// A frame is dropped when the slot it would use is still in flight.
+struct FrameCapture {
+	enum {
+		SlotCount = 4
+	};
+	enum class eSlotState : int {
+		Free = 0,
+		Reading,	// glReadPixels issued, waiting for the fence
+		Writing,	// owned by the worker thread
+	};
+	struct Slot {
+		GLuint bufferId = 0;
+		unsigned char* pMappedMemory = nullptr;
+		GLsizeiptr capacity = 0;
+		GLsync fence = nullptr;
+		int width = 0;
+		int height = 0;
+		unsigned int frameNumber = 0;
+		std::atomic<eSlotState> state{ eSlotState::Free };
+	};
+
+	Slot slots[SlotCount];
+	unsigned int writeSlot = 0;		// next slot read into, slots are handed to the worker in the same order
+	unsigned int pendingSlot = 0;	// oldest slot still reading
+
+	eCaptureFormat format = eCaptureFormat::PPM;
+	char pathPrefix[512] = {};		// files are <pathPrefix>_<frame number>.ppm or .raw
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<unsigned int> queue;	// slots to write, guarded by mutex
+	bool stopWorker = false;
+	bool stopping = false;		// stopFrameCapture was called, the frames in flight are still written
+
+	// stats
+	unsigned int capturedFrames = 0;
+	unsigned int droppedFrames = 0;
+	std::atomic<unsigned int> writtenFrames{ 0 };
+};
+
+bool createFrameCapture(FrameCapture& capture, char const* szPathPrefix, eCaptureFormat format);
+
+// finishes the frames in flight and stops the worker thread, waits for the GPU and the disk
+void deleteFrameCapture(FrameCapture& capture);
+
+// no frame is captured anymore, finishFrameCapture writes the frames in flight without waiting
+void stopFrameCapture(FrameCapture& capture);
+// call once per frame after stopFrameCapture, true once every frame is written and the worker has stopped
+bool finishFrameCapture(FrameCapture& capture);
+
+// reads the color buffer of the bound read framebuffer, call before swapping buffers
+void captureFrame(FrameCapture& capture, int width, int height);
@@ -0,0 +1,99 @@
+#include "frustum.h"
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+	glm::vec4 normalizePlane(const glm::vec4& plane) {
+		return plane / glm::length(glm::vec3(plane));
+	}
+}
+
+void extractFrustumPlanes(Frustum& frustum, const glm::mat4& viewProjection) {
+	// Gribb & Hartmann: the clip space inequalities -w <= x, y, z <= w are combinations of the rows of the matrix
+	const glm::mat4& m = viewProjection;
+	const glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	frustum.planes[Frustum::Left] = normalizePlane(row3 + row0);
+	frustum.planes[Frustum::Right] = normalizePlane(row3 - row0);
+	frustum.planes[Frustum::Bottom] = normalizePlane(row3 + row1);
+	frustum.planes[Frustum::Top] = normalizePlane(row3 - row1);
+	frustum.planes[Frustum::Near] = normalizePlane(row3 + row2);
+	frustum.planes[Frustum::Far] = normalizePlane(row3 - row2);
+}
+
+bool testSphere(const Frustum& frustum, const glm::vec4& sphere) {
+	for (int iPlane = 0; iPlane < Frustum::PlaneCount; ++iPlane) {
+		const glm::vec4& plane = frustum.planes[iPlane];
+		if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+			return false;
+		}
+	}
+	return true;
+}
+
+unsigned int testSpheres(const Frustum& frustum, glm::vec4 const* spheres, unsigned int count, uint8_t* pVisible) {
+	unsigned int visibleCount = 0;
+	unsigned int iSphere = 0;
+
+#ifdef FRUSTUM_SSE
+	__m128 planeX[Frustum::PlaneCount];
+	__m128 planeY[Frustum::PlaneCount];
+	__m128 planeZ[Frustum::PlaneCount];
+	__m128 planeW[Frustum::PlaneCount];
+	for (int iPlane = 0; iPlane < Frustum::PlaneCount; ++iPlane) {
+		planeX[iPlane] = _mm_set1_ps(frustum.planes[iPlane].x);
+		planeY[iPlane] = _mm_set1_ps(frustum.planes[iPlane].y);
+		planeZ[iPlane] = _mm_set1_ps(frustum.planes[iPlane].z);
+		planeW[iPlane] = _mm_set1_ps(frustum.planes[iPlane].w);
+	}
+
+	for (; iSphere + 4 <= count; iSphere += 4) {
+		// 4 spheres transposed to x, y, z and radius registers
+		__m128 x = _mm_loadu_ps(&spheres[iSphere].x);
+		__m128 y = _mm_loadu_ps(&spheres[iSphere + 1].x);
+		__m128 z = _mm_loadu_ps(&spheres[iSphere + 2].x);
+		__m128 radius = _mm_loadu_ps(&spheres[iSphere + 3].x);
+		_MM_TRANSPOSE4_PS(x, y, z, radius);
+		const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+		__m128 inside = _mm_cmpge_ps(
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[0], x), _mm_mul_ps(planeY[0], y)), _mm_add_ps(_mm_mul_ps(planeZ[0], z), planeW[0])),
+			negRadius);
+		for (int iPlane = 1; iPlane < Frustum::PlaneCount; ++iPlane) {
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[iPlane], x), _mm_mul_ps(planeY[iPlane], y)), _mm_add_ps(_mm_mul_ps(planeZ[iPlane], z), planeW[iPlane]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (int i = 0; i < 4; ++i) {
+			pVisible[iSphere + i] = uint8_t((mask >> i) & 1);
+			visibleCount += (mask >> i) & 1;
+		}
+	}
+#endif
+
+	for (; iSphere < count; ++iSphere) {
+		pVisible[iSphere] = testSphere(frustum, spheres[iSphere]) ? 1 : 0;
+		visibleCount += pVisible[iSphere];
+	}
+	return visibleCount;
+}
+
+glm::vec4 getBoundingSphere(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+	return glm::vec4((boxMin + boxMax) * 0.5f, glm::length(boxMax - boxMin) * 0.5f);
+}
+
+glm::vec4 transformBoundingSphere(const glm::vec4& sphere, const glm::mat4& model) {
+	const glm::vec4 center = model * glm::vec4(glm::vec3(sphere), 1.f);
+	const float scale2 = glm::max(glm::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])), glm::dot(glm::vec3(model[1]), glm::vec3(model[1]))), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])));
+	return glm::vec4(glm::vec3(center), sphere.w * glm::sqrt(scale2));
+}
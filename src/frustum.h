@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <stdint.h>
+
+// Planes of a view frustum, a point p is inside a plane when dot(plane, vec4(p, 1)) >= 0.
+// Planes are normalized so that the dot product is a signed distance.
+struct Frustum {
+	enum {
+		Left = 0,
+		Right,
+		Bottom,
+		Top,
+		Near,
+		Far,
+		PlaneCount
+	};
+	glm::vec4 planes[PlaneCount];
+};
+
+// planes in the space the matrix transforms from: world space for projection * view
+void extractFrustumPlanes(Frustum& frustum, const glm::mat4& viewProjection);
+
+// spheres are xyz center, w radius
+bool testSphere(const Frustum& frustum, const glm::vec4& sphere);
+
+// writes 1 in pVisible for the spheres intersecting the frustum, 0 otherwise, and returns the visible count
+// four spheres are tested at once with SSE when available
+unsigned int testSpheres(const Frustum& frustum, glm::vec4 const* spheres, unsigned int count, uint8_t* pVisible);
+
+// sphere enclosing the box
+glm::vec4 getBoundingSphere(const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+// sphere enclosing the transformed sphere, the radius is scaled by the largest axis scale of the matrix
+glm::vec4 transformBoundingSphere(const glm::vec4& sphere, const glm::mat4& model);
@@ -0,0 +1,91 @@
+#include "glstate.h"
+
+namespace {
+	// true when the state has to be changed
+	bool updateState(GLStateCache& cache, GLuint& current, GLuint value) {
+		if (current == value) {
+			++cache.redundantChangesAvoided;
+			return false;
+		}
+		current = value;
+		++cache.stateChanges;
+		return true;
+	}
+
+	void enable(GLenum capability, bool enabled) {
+		if (enabled) {
+			glEnable(capability);
+		}
+		else {
+			glDisable(capability);
+		}
+	}
+}
+
+void invalidateGLStateCache(GLStateCache& cache) {
+	cache.blendEnabled = GLStateCache::Unknown;
+	cache.blendSrcRGB = GLStateCache::Unknown;
+	cache.blendDstRGB = GLStateCache::Unknown;
+	cache.blendSrcAlpha = GLStateCache::Unknown;
+	cache.blendDstAlpha = GLStateCache::Unknown;
+	cache.depthTestEnabled = GLStateCache::Unknown;
+	cache.depthWriteEnabled = GLStateCache::Unknown;
+	cache.primitiveRestartEnabled = GLStateCache::Unknown;
+	cache.program = GLStateCache::Unknown;
+	cache.vao = GLStateCache::Unknown;
+}
+
+void setBlendEnabled(GLStateCache& cache, bool enabled) {
+	if (updateState(cache, cache.blendEnabled, enabled)) {
+		enable(GL_BLEND, enabled);
+	}
+}
+
+void setBlendFunc(GLStateCache& cache, GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha) {
+	if (cache.blendSrcRGB == srcRGB && cache.blendDstRGB == dstRGB && cache.blendSrcAlpha == srcAlpha && cache.blendDstAlpha == dstAlpha) {
+		++cache.redundantChangesAvoided;
+		return;
+	}
+	cache.blendSrcRGB = srcRGB;
+	cache.blendDstRGB = dstRGB;
+	cache.blendSrcAlpha = srcAlpha;
+	cache.blendDstAlpha = dstAlpha;
+	++cache.stateChanges;
+	glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+}
+
+void setDepthTestEnabled(GLStateCache& cache, bool enabled) {
+	if (updateState(cache, cache.depthTestEnabled, enabled)) {
+		enable(GL_DEPTH_TEST, enabled);
+	}
+}
+
+void setDepthWriteEnabled(GLStateCache& cache, bool enabled) {
+	if (updateState(cache, cache.depthWriteEnabled, enabled)) {
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void setPrimitiveRestartEnabled(GLStateCache& cache, bool enabled) {
+	if (updateState(cache, cache.primitiveRestartEnabled, enabled)) {
+		enable(GL_PRIMITIVE_RESTART_FIXED_INDEX, enabled);
+	}
+}
+
+void useProgram(GLStateCache& cache, GLuint program) {
+	if (updateState(cache, cache.program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void bindVertexArray(GLStateCache& cache, GLuint vao) {
+	if (updateState(cache, cache.vao, vao)) {
+		glBindVertexArray(vao);
+	}
+}
+
+void onVertexArrayDeleted(GLStateCache& cache, GLuint vao) {
+	if (cache.vao == vao) {
+		cache.vao = 0;
+	}
+}
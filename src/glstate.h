@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad.h>
+
+// Shadow copy of the GL state changed by the render engine, so that redundant changes are skipped
+// and the state never has to be read back with glGet.
+// Code changing these states behind the cache must call invalidateGLStateCache.
+struct GLStateCache {
+	enum : GLuint {
+		Unknown = ~0u
+	};
+
+	GLuint blendEnabled = Unknown;
+	GLuint blendSrcRGB = Unknown;
+	GLuint blendDstRGB = Unknown;
+	GLuint blendSrcAlpha = Unknown;
+	GLuint blendDstAlpha = Unknown;
+	GLuint depthTestEnabled = Unknown;
+	GLuint depthWriteEnabled = Unknown;
+	GLuint primitiveRestartEnabled = Unknown;
+	GLuint program = Unknown;
+	GLuint vao = Unknown;
+
+	// counters, reset by the user
+	unsigned int stateChanges = 0;
+	unsigned int redundantChangesAvoided = 0;
+};
+
+// every state is set on its next use
+void invalidateGLStateCache(GLStateCache& cache);
+
+void setBlendEnabled(GLStateCache& cache, bool enabled);
+void setBlendFunc(GLStateCache& cache, GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+void setDepthTestEnabled(GLStateCache& cache, bool enabled);
+void setDepthWriteEnabled(GLStateCache& cache, bool enabled);
+// GL_PRIMITIVE_RESTART_FIXED_INDEX, only enabled around the draws of indexed line strips
+void setPrimitiveRestartEnabled(GLStateCache& cache, bool enabled);
+void useProgram(GLStateCache& cache, GLuint program);
+void bindVertexArray(GLStateCache& cache, GLuint vao);
+
+// deleting the bound vertex array binds 0, call it when deleting a vertex array possibly bound through the cache
+void onVertexArrayDeleted(GLStateCache& cache, GLuint vao);
@@ -0,0 +1,85 @@
+#include "gputimer.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace {
+	// the results of a slot, false when some of them are not available yet
+	bool readGpuTimersSlot(GpuTimers& timers, int slot) {
+		const unsigned int issuedPasses = timers.issuedPasses[slot];
+
+		// queries complete in order: the slot is available when its last query is
+		for (int iPass = (int)eGpuPass::Count - 1; iPass >= 0; --iPass) {
+			if (issuedPasses & (1u << iPass)) {
+				GLint available = 0;
+				glGetQueryObjectiv(timers.queries[slot][iPass][1], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available) {
+					return false;
+				}
+				break;
+			}
+		}
+
+		for (int iPass = 0; iPass < (int)eGpuPass::Count; ++iPass) {
+			float time = 0.f;
+			if (issuedPasses & (1u << iPass)) {
+				GLuint64 begin = 0;
+				GLuint64 end = 0;
+				glGetQueryObjectui64v(timers.queries[slot][iPass][0], GL_QUERY_RESULT, &begin);
+				glGetQueryObjectui64v(timers.queries[slot][iPass][1], GL_QUERY_RESULT, &end);
+				time = float(double(end - begin) * 1e-6);
+			}
+			timers.passTimes[iPass] = time;
+			timers.history[iPass][timers.historyOffset] = time;
+		}
+		timers.historyOffset = (timers.historyOffset + 1) % GpuTimers::HistorySize;
+		return true;
+	}
+}
+
+bool createGpuTimers(GpuTimers& timers) {
+	glGenQueries(sizeof(timers.queries) / sizeof(GLuint), &timers.queries[0][0][0]);
+	memset(timers.issuedPasses, 0, sizeof(timers.issuedPasses));
+	timers.frameIndex = 0;
+	return true;
+}
+
+void deleteGpuTimers(GpuTimers& timers) {
+	glDeleteQueries(sizeof(timers.queries) / sizeof(GLuint), &timers.queries[0][0][0]);
+	memset(timers.queries, 0, sizeof(timers.queries));
+}
+
+void beginGpuTimersFrame(GpuTimers& timers) {
+	timers.frameIndex = (timers.frameIndex + 1) % GpuTimers::FrameLatency;
+	if (timers.issuedPasses[timers.frameIndex] && !readGpuTimersSlot(timers, timers.frameIndex)) {
+		++timers.droppedFrames;
+	}
+	timers.issuedPasses[timers.frameIndex] = 0;
+}
+
+void beginGpuPass(GpuTimers& timers, eGpuPass pass) {
+	assert(timers.queries[0][0][0]); // did you call createGpuTimers ?
+	glQueryCounter(timers.queries[timers.frameIndex][(int)pass][0], GL_TIMESTAMP);
+}
+
+void endGpuPass(GpuTimers& timers, eGpuPass pass) {
+	glQueryCounter(timers.queries[timers.frameIndex][(int)pass][1], GL_TIMESTAMP);
+	timers.issuedPasses[timers.frameIndex] |= 1u << (int)pass;
+}
+
+char const* getGpuPassName(eGpuPass pass) {
+	switch (pass) {
+	case eGpuPass::Opaque3D:
+		return "3D";
+	case eGpuPass::Custom3D:
+		return "3D custom";
+	case eGpuPass::Transparent3D:
+		return "3D transparent";
+	case eGpuPass::Overlay2D:
+		return "2D";
+	case eGpuPass::ImGui:
+		return "ImGui";
+	default:
+		return "";
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad.h>
+
+// GPU passes timed by the render engine, ImGui is timed by the viewer
+enum class eGpuPass {
+	Opaque3D = 0,		// clear and opaque draws of render3D
+	Custom3D,			// opaque draws of render3D_custom
+	Transparent3D,		// transparent draws of both 3D passes
+	Overlay2D,
+	ImGui,
+	Count
+};
+
+// GL_TIMESTAMP queries around each pass, in a ring of frames.
+// A frame is read back when its slot is reused, FrameLatency frames later: the results are always available
+// by then on a GPU that keeps up, a frame that is still pending is dropped instead of waiting for it.
+struct GpuTimers {
+	static constexpr int FrameLatency = 4;
+	static constexpr int HistorySize = 120;
+
+	GLuint queries[FrameLatency][(int)eGpuPass::Count][2] = {};	// begin and end timestamps
+	unsigned int issuedPasses[FrameLatency] = {};	// bit per pass whose queries were issued in the slot
+	int frameIndex = 0;
+
+	// milliseconds of the last frame read back, 0 for a pass that was not drawn
+	float passTimes[(int)eGpuPass::Count] = {};
+	// rolling history of passTimes, the oldest value at historyOffset
+	float history[(int)eGpuPass::Count][HistorySize] = {};
+	int historyOffset = 0;
+	unsigned int droppedFrames = 0;
+};
+
+bool createGpuTimers(GpuTimers& timers);
+void deleteGpuTimers(GpuTimers& timers);
+
+// moves to the next slot of the ring and reads back the frame issued in it
+void beginGpuTimersFrame(GpuTimers& timers);
+
+void beginGpuPass(GpuTimers& timers, eGpuPass pass);
+void endGpuPass(GpuTimers& timers, eGpuPass pass);
+
+char const* getGpuPassName(eGpuPass pass);
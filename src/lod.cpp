@@ -0,0 +1,35 @@
+#include "lod.h"
+
+#include <glm/trigonometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <assert.h>
+
+const unsigned int lodSubdivisions[LodLevelCount] = { 6, 8, 12, 16, 24, 32, 48, 64 };
+
+unsigned int getLodLevel(float pixelRadius) {
+	// the middle of an edge of a polygon with n sides is r * (1 - cos(pi / n)) inside the circle
+	constexpr float maxErrorPixels = 0.5f;
+	for (unsigned int level = 0; level < LodLevelCount - 1; ++level) {
+		const float error = pixelRadius * (1.f - glm::cos(glm::pi<float>() / lodSubdivisions[level]));
+		if (error <= maxErrorPixels) {
+			return level;
+		}
+	}
+	return LodLevelCount - 1;
+}
+
+glm::vec2 const* getCircleTable(CircleTables& tables, unsigned int level) {
+	assert(level < LodLevelCount);
+	std::vector<glm::vec2>& table = tables.levels[level];
+	if (table.empty()) {
+		const unsigned int subdivisions = lodSubdivisions[level];
+		table.resize(subdivisions + 1);
+		for (unsigned int i = 0; i < subdivisions; ++i) {
+			const float angle = glm::two_pi<float>() * i / float(subdivisions);
+			table[i] = glm::vec2(glm::cos(angle), glm::sin(angle));
+		}
+		table[subdivisions] = table[0];
+	}
+	return table.data();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+
+#include <vector>
+
+// Automatic tessellation of the round primitives (solidSphere, circleFill, circleContour):
+// the subdivision count is taken from a fixed set of levels so that the polygon stays
+// within half a pixel of the true circle, which also keeps the number of cached meshes small.
+enum {
+	LodLevelCount = 8
+};
+
+extern const unsigned int lodSubdivisions[LodLevelCount];
+
+// level of a circle or a sphere whose radius covers pixelRadius pixels on screen
+unsigned int getLodLevel(float pixelRadius);
+
+// points of the unit circle for each level, lodSubdivisions[level] + 1 points so that the last one closes the loop
+struct CircleTables {
+	std::vector<glm::vec2> levels[LodLevelCount];
+};
+
+glm::vec2 const* getCircleTable(CircleTables& tables, unsigned int level);
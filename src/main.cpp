@@ -3,6 +3,10 @@
 #include "renderapi.h"
 #include "libs.h"
 
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <vector>
 #include <imgui.h>
@@ -135,6 +139,10 @@ struct MyViewer : Viewer {
 		additionalShaderData.bounceSpeed = 30.f;
 		additionalShaderData.count = 0;
 
+		pCustomShaderData = &additionalShaderData;
+		CustomShaderDataSize = sizeof(VertexShaderAdditionalData);
+		markCustomShaderDataDirty();
+
 		// Forward Kinematic
 		/*
 		for (int i = 0; i < 3; i++)
@@ -165,13 +173,16 @@ struct MyViewer : Viewer {
 
 		//boneAngle = (float)elapsedTime;
 
-		leftMouseButtonPressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-
-		altKeyPressed = glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_ALT) == GLFW_PRESS;
-
-		double mouseX;
-		double mouseY;
-		glfwGetCursorPos(window, &mouseX, &mouseY);
+		// no input in headless mode without a window
+		leftMouseButtonPressed = false;
+		altKeyPressed = false;
+		double mouseX = 0.0;
+		double mouseY = 0.0;
+		if (window) {
+			leftMouseButtonPressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+			altKeyPressed = glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_ALT) == GLFW_PRESS;
+			glfwGetCursorPos(window, &mouseX, &mouseY);
+		}
 
 		mousePos = { float(mouseX), viewportHeight - float(mouseY) };
 
@@ -182,6 +193,8 @@ struct MyViewer : Viewer {
 
 			if (additionalShaderData.count < BOUNCE_ARRAY_SIZE) {
 				additionalShaderData.posAndTime[additionalShaderData.count] = posAndTime;
+				markCustomShaderDataDirty((int)offsetof(VertexShaderAdditionalData, count), (int)sizeof(int));
+				markCustomShaderDataDirty(int(offsetof(VertexShaderAdditionalData, posAndTime) + additionalShaderData.count * sizeof(glm::vec4)), (int)sizeof(glm::vec4));
 				additionalShaderData.count++;
 			}
 			else {
@@ -193,14 +206,11 @@ struct MyViewer : Viewer {
 					}
 				}
 				additionalShaderData.posAndTime[oldest] = posAndTime;
+				markCustomShaderDataDirty(int(offsetof(VertexShaderAdditionalData, posAndTime) + oldest * sizeof(glm::vec4)), (int)sizeof(glm::vec4));
 
 			}
 		}
 
-
-		pCustomShaderData = &additionalShaderData;
-		CustomShaderDataSize = sizeof(VertexShaderAdditionalData);
-
 		// Particles
 		/*
 		spawningTimer += (elapsedTime - lastFrameElapsedTime);
@@ -299,6 +309,7 @@ struct MyViewer : Viewer {
 
 	void render3D_custom(const RenderApi3D& api) const override {
 		//Here goes your drawcalls affected by the custom vertex shader
+		//api.customShader("#define ShaderType 2\n"); // the next draws use the wave effect
 		//api.horizontalPlane(glm::vec3( 0., 2.0, 0. ), { 4, 4 }, 200, glm::vec4(0.0f, 0.2f, 1.f, 1.f));
 	}
 
@@ -337,7 +348,7 @@ struct MyViewer : Viewer {
 			api.solidSphere(childAbsPos, 0.05f, 10, 10, white);
 		}
 
-		api.solidSphere(ballPosition, 0.5f, 100, 100, white);
+		api.solidSphere(ballPosition, 0.5f, AutoSubdivisions, AutoSubdivisions, white);
 
 		{
 			glm::vec3 vertices[] = {
@@ -369,16 +380,20 @@ struct MyViewer : Viewer {
 
 		// IK
 
-		// knee bone
-		api.bone(knee.RelativePosition, white, hip.AbsoluteRotation, hip.AbsolutePosition);
-		api.solidSphere(knee.AbsolutePosition, 0.05f, 5, 5, white);
-
-		// heel bone
-		api.bone(heel.RelativePosition, white, knee.AbsoluteRotation, knee.AbsolutePosition);
-		api.solidSphere(heel.AbsolutePosition, 0.05f, 5, 5, white);
-
-		// target
-		api.solidSphere(targetPosition, 0.1f, 5, 5, red);
+		// knee and heel bones
+		const BoneInstance legBones[] = {
+			{ hip.AbsoluteRotation, hip.AbsolutePosition, knee.RelativePosition, white },
+			{ knee.AbsoluteRotation, knee.AbsolutePosition, heel.RelativePosition, white },
+		};
+		api.bones(legBones, COUNTOF(legBones));
+
+		// joints and target
+		const SphereInstance legJoints[] = {
+			{ knee.AbsolutePosition, 0.05f, white },
+			{ heel.AbsolutePosition, 0.05f, white },
+			{ targetPosition, 0.1f, red },
+		};
+		api.solidSpheres(legJoints, COUNTOF(legJoints), AutoSubdivisions, AutoSubdivisions);
 
 	}
 
@@ -388,10 +403,10 @@ struct MyViewer : Viewer {
 
 		if (altKeyPressed) {
 			if (leftMouseButtonPressed) {
-				api.circleFill(mousePos, padding, 10, white);
+				api.circleFill(mousePos, padding, AutoSubdivisions, white);
 			}
 			else {
-				api.circleContour(mousePos, padding, 10, white);
+				api.circleContour(mousePos, padding, AutoSubdivisions, white);
 			}
 
 		}
@@ -453,6 +468,14 @@ struct MyViewer : Viewer {
 			camera.fov = glm::radians(fovDegrees);
 		}
 
+		ImGui::Separator();
+		ImGui::Text("3D draw commands: %u, draw calls: %u, 2D draw calls: %u", renderStats.drawCommands3D, renderStats.drawCalls3D, renderStats.drawCalls2D);
+		ImGui::Text("GL state changes: %u, redundant avoided: %u", renderStats.stateChanges, renderStats.redundantStateChangesAvoided);
+		ImGui::Checkbox("Frustum culling", &frustumCulling3D);
+		ImGui::Checkbox("Analytic 2D circles", &analyticShapes2D);
+		ImGui::Text("3D objects visible: %u, culled: %u", renderStats.visibleObjects3D, renderStats.culledObjects3D);
+		ImGui::Text("3D transparent draw commands: %u", renderStats.transparentCommands3D);
+
 		//ImGui::SliderFloat3("Cube Position", (float(&)[3])cubePosition, -1.f, 1.f);
 
 		// particles
@@ -496,7 +519,28 @@ struct MyViewer : Viewer {
 	}
 };
 
+// --headless [frameCount] renders offscreen and exits, --output path.ppm writes the last frame
+// --capture pathPrefix writes every frame from the start
 int main(int argc, char** argv) {
 	MyViewer v;
+	for (int iArg = 1; iArg < argc; ++iArg) {
+		if (!strcmp(argv[iArg], "--headless")) {
+			v.headless = true;
+			if (iArg + 1 < argc && atoi(argv[iArg + 1]) > 0) {
+				v.headlessFrameCount = atoi(argv[++iArg]);
+			}
+		}
+		else if (!strcmp(argv[iArg], "--output") && iArg + 1 < argc) {
+			strncpy(v.headlessOutputPath, argv[++iArg], COUNTOF(v.headlessOutputPath) - 1);
+		}
+		else if (!strcmp(argv[iArg], "--capture") && iArg + 1 < argc) {
+			v.captureFrames = true;
+			strncpy(v.capturePathPrefix, argv[++iArg], COUNTOF(v.capturePathPrefix) - 1);
+		}
+		else {
+			fprintf(stderr, "Unknown argument %s\n", argv[iArg]);
+			return -1;
+		}
+	}
 	return v.run();
 }
@@ -0,0 +1,344 @@
+#include "meshcache.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <vector>
+
+#define COUNTOF(ARRAY) (sizeof(ARRAY) / sizeof(ARRAY[0]))
+
+namespace {
+	enum class eCachedMesh : uint64_t {
+		Sphere = 0,
+		Cube,
+		Bone,
+		Grid,
+		Axis,
+		Plane,
+	};
+
+	uint64_t makeMeshKey(eCachedMesh mesh, unsigned int paramA = 0, unsigned int paramB = 0) {
+		return (uint64_t(mesh) << 48) | (uint64_t(paramA & 0xFFFFFF) << 24) | uint64_t(paramB & 0xFFFFFF);
+	}
+
+	const Buffer3D& addMesh(MeshCache& cache, uint64_t key, const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<unsigned int>& indices) {
+		CreateBuffer3DParams params;
+		params.pVertices = vertices.data();
+		params.pNormals = normals.empty() ? nullptr : normals.data();
+		params.pColors = nullptr;
+		params.pIndices = indices.empty() ? nullptr : indices.data();
+		params.vertexCount = (GLsizei)vertices.size();
+		params.indexCount = (GLsizei)indices.size();
+		params.format = eVertexFormat3D::PackedHalf; // every coordinate is within [-1, 1]
+		params.defaultVertexBuffer = cache.defaultVertexBuffer;
+
+		Buffer3D& buffer = cache.meshes[key];
+		createBuffer3D(buffer, params);
+		return buffer;
+	}
+}
+
+void deleteMeshCache(MeshCache& cache) {
+	for (auto& entry : cache.meshes) {
+		deleteBuffer3D(entry.second);
+	}
+	cache.meshes.clear();
+
+	for (auto& entry : cache.instancedVaos) {
+		glDeleteVertexArrays(1, &entry.second);
+	}
+	cache.instancedVaos.clear();
+}
+
+GLuint getInstancedVertexArray(MeshCache& cache, const Buffer3D& mesh, GLuint instanceBuffer) {
+	GLuint& vao = cache.instancedVaos[mesh.vao];
+	if (vao == 0) {
+		createInstancedVertexArray3D(vao, mesh, instanceBuffer);
+	}
+	return vao;
+}
+
+const Buffer3D& getSphereMesh(MeshCache& cache, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions) {
+	const uint64_t key = makeMeshKey(eCachedMesh::Sphere, horizontalSubdivisions, verticalSubdivisions);
+	auto found = cache.meshes.find(key);
+	if (found != cache.meshes.end()) {
+		return found->second;
+	}
+
+	const unsigned int vertexCount = 2 + horizontalSubdivisions * (verticalSubdivisions - 1);
+	const unsigned int indexCount = (2 * horizontalSubdivisions + (verticalSubdivisions - 2) * horizontalSubdivisions * 2) * 3;
+
+	std::vector<glm::vec3> vertices;
+	vertices.reserve(vertexCount);
+
+	const float verticalStep = glm::pi<float>() / verticalSubdivisions;
+	const float horizontalStep = glm::two_pi<float>() / horizontalSubdivisions;
+	for (unsigned int i = 1; i < verticalSubdivisions; ++i) {
+		const float verticalAngle = glm::half_pi<float>() - i * verticalStep;
+
+		const float xz = glm::cos(verticalAngle);
+		const float y = glm::sin(verticalAngle);
+
+		for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
+			const float horizontalAngle = j * horizontalStep;
+			const float x = xz * glm::cos(horizontalAngle);
+			const float z = xz * glm::sin(horizontalAngle);
+			vertices.push_back(glm::vec3(x, y, z));
+		}
+	}
+
+	vertices.push_back(glm::vec3(0.f, 1.f, 0.f));
+	vertices.push_back(glm::vec3(0.f, -1.f, 0.f));
+
+	// unit sphere: normals are the positions
+	const std::vector<glm::vec3>& normals = vertices;
+
+	std::vector<unsigned int> indices;
+	indices.reserve(indexCount);
+
+	const unsigned int iFirstLine = 0;
+	for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
+		indices.push_back(vertexCount - 2);
+		indices.push_back(iFirstLine + j);
+		indices.push_back(iFirstLine + ((j + 1) % horizontalSubdivisions));
+	}
+
+	for (unsigned int i = 0; i < verticalSubdivisions - 2; ++i) {
+		for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
+			const unsigned int iA = (i * horizontalSubdivisions) + j;
+			const unsigned int iB = (i * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
+			const unsigned int iC = ((i + 1) * horizontalSubdivisions) + j;
+			const unsigned int iD = ((i + 1) * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
+			indices.push_back(iA);
+			indices.push_back(iC);
+			indices.push_back(iD);
+			indices.push_back(iA);
+			indices.push_back(iD);
+			indices.push_back(iB);
+		}
+	}
+
+	const unsigned int iLastLine = (verticalSubdivisions - 2) * horizontalSubdivisions;
+	for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
+		indices.push_back(vertexCount - 1);
+		indices.push_back(iLastLine + j);
+		indices.push_back(iLastLine + ((j + 1) % horizontalSubdivisions));
+	}
+
+	return addMesh(cache, key, vertices, normals, indices);
+}
+
+const Buffer3D& getCubeMesh(MeshCache& cache) {
+	const uint64_t key = makeMeshKey(eCachedMesh::Cube);
+	auto found = cache.meshes.find(key);
+	if (found != cache.meshes.end()) {
+		return found->second;
+	}
+
+	const float halfsize = 0.5f;
+	glm::vec3 edges[8] =
+	{
+		{ -halfsize, -halfsize, -halfsize},
+		{ +halfsize, -halfsize, -halfsize},
+		{ +halfsize, +halfsize, -halfsize},
+		{ -halfsize, +halfsize, -halfsize},
+		{ -halfsize, -halfsize, +halfsize},
+		{ +halfsize, -halfsize, +halfsize},
+		{ +halfsize, +halfsize, +halfsize},
+		{ -halfsize, +halfsize, +halfsize},
+	};
+
+	glm::vec3 faceNormals[6] =
+	{
+		{ 0, 0, -1 },
+		{ +1, 0, 0 },
+		{ 0, 0, +1 },
+		{ -1, 0, 0 },
+		{ 0, +1, 0 },
+		{ 0, -1, 0 },
+	};
+
+	int indices[36] =
+	{
+		0, 1, 3, 3, 1, 2,
+		1, 5, 2, 2, 5, 6,
+		5, 4, 6, 6, 4, 7,
+		4, 0, 7, 7, 0, 3,
+		3, 2, 7, 7, 2, 6,
+		4, 5, 0, 0, 5, 1
+	};
+
+	std::vector<glm::vec3> vertices(COUNTOF(indices));
+	std::vector<glm::vec3> normals(COUNTOF(indices));
+	for (int i = 0; i < 36; i++) {
+		vertices[i] = edges[indices[i]];
+		normals[i] = faceNormals[i / 6];
+	}
+
+	return addMesh(cache, key, vertices, normals, {});
+}
+
+const Buffer3D& getBoneMesh(MeshCache& cache) {
+	const uint64_t key = makeMeshKey(eCachedMesh::Bone);
+	auto found = cache.meshes.find(key);
+	if (found != cache.meshes.end()) {
+		return found->second;
+	}
+
+	// left is X, up is Y and front is Z
+	const float size = 1.f / 10.f;
+	const glm::vec3 up = glm::vec3(0.f, size, 0.f);
+	const glm::vec3 left = glm::vec3(size, 0.f, 0.f);
+	const glm::vec3 front = glm::vec3(0.f, 0.f, size);
+
+	glm::vec3 edges[] = {
+		glm::vec3(0.f),
+		up + front,
+		-up + front,
+		left + front,
+		-left + front,
+		glm::vec3(0.f, 0.f, 1.f),
+	};
+
+	unsigned int indices[] = {
+		0, 1, 3,
+		0, 4, 1,
+		0, 3, 2,
+		0, 2, 4,
+		5, 3, 1,
+		5, 1, 4,
+		5, 2, 3,
+		5, 4, 2,
+	};
+	constexpr unsigned int vertexCount = COUNTOF(indices);
+
+	std::vector<glm::vec3> vertices(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; ++i) {
+		vertices[i] = edges[indices[i]];
+	}
+
+	std::vector<glm::vec3> normals(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i += 3) {
+		glm::vec3 normal = glm::normalize(glm::cross(edges[indices[i + 1]] - edges[indices[i + 0]], edges[indices[i + 2]] - edges[indices[i + 0]]));
+		normals[i + 0] = normal;
+		normals[i + 1] = normal;
+		normals[i + 2] = normal;
+	}
+
+	return addMesh(cache, key, vertices, normals, {});
+}
+
+const Buffer3D& getGridMesh(MeshCache& cache, unsigned int subdivisions) {
+	const uint64_t key = makeMeshKey(eCachedMesh::Grid, subdivisions);
+	auto found = cache.meshes.find(key);
+	if (found != cache.meshes.end()) {
+		return found->second;
+	}
+
+	const unsigned int lineCount = 4 + 2 * (subdivisions - 1);
+	const unsigned int vertexCount = 2 * lineCount;
+	std::vector<glm::vec3> vertices;
+	vertices.reserve(vertexCount);
+
+	const float size = 1.f;
+	const float halfSize = 0.5f * size;
+
+	vertices.push_back(glm::vec3(-halfSize, 0.f, halfSize));
+	vertices.push_back(glm::vec3(halfSize, 0.f, halfSize));
+	vertices.push_back(glm::vec3(-halfSize, 0.f, -halfSize));
+	vertices.push_back(glm::vec3(halfSize, 0.f, -halfSize));
+	vertices.push_back(glm::vec3(-halfSize, 0.f, halfSize));
+	vertices.push_back(glm::vec3(-halfSize, 0.f, -halfSize));
+	vertices.push_back(glm::vec3(halfSize, 0.f, halfSize));
+	vertices.push_back(glm::vec3(halfSize, 0.f, -halfSize));
+
+	for (unsigned int i = 1; i < subdivisions; ++i) {
+		const float coord = -halfSize + size * (i / float(subdivisions));
+		vertices.push_back(glm::vec3(coord, 0.f, -halfSize));
+		vertices.push_back(glm::vec3(coord, 0.f, halfSize));
+		vertices.push_back(glm::vec3(-halfSize, 0.f, coord));
+		vertices.push_back(glm::vec3(halfSize, 0.f, coord));
+	}
+
+	return addMesh(cache, key, vertices, {}, {});
+}
+
+const Buffer3D& getAxisMesh(MeshCache& cache) {
+	const uint64_t key = makeMeshKey(eCachedMesh::Axis);
+	auto found = cache.meshes.find(key);
+	if (found != cache.meshes.end()) {
+		return found->second;
+	}
+
+	glm::vec3 vertices[] = {
+		glm::vec3(0.f, 0.f, 0.f),
+		glm::vec3(1.f, 0.f, 0.f),
+		glm::vec3(0.f, 0.f, 0.f),
+		glm::vec3(0.f, 1.f, 0.f),
+		glm::vec3(0.f, 0.f, 0.f),
+		glm::vec3(0.f, 0.f, 1.f),
+	};
+	constexpr size_t vertexCount = COUNTOF(vertices);
+
+	glm::vec4 colors[] = {
+		glm::vec4(1.f, 0.f, 0.f, 1.f),
+		glm::vec4(1.f, 0.f, 0.f, 1.f),
+		glm::vec4(0.f, 1.f, 0.f, 1.f),
+		glm::vec4(0.f, 1.f, 0.f, 1.f),
+		glm::vec4(0.f, 0.f, 1.f, 1.f),
+		glm::vec4(0.f, 0.f, 1.f, 1.f),
+	};
+
+	CreateBuffer3DParams params;
+	params.pVertices = vertices;
+	params.pNormals = nullptr;
+	params.pColors = colors;
+	params.vertexCount = vertexCount;
+	params.format = eVertexFormat3D::PackedHalf;
+	params.defaultVertexBuffer = cache.defaultVertexBuffer;
+
+	Buffer3D& buffer = cache.meshes[key];
+	createBuffer3D(buffer, params);
+	return buffer;
+}
+
+const Buffer3D& getPlaneMesh(MeshCache& cache, unsigned int sideSubdivisions) {
+	const uint64_t key = makeMeshKey(eCachedMesh::Plane, sideSubdivisions);
+	auto found = cache.meshes.find(key);
+	if (found != cache.meshes.end()) {
+		return found->second;
+	}
+
+	const unsigned int NbVertexBySide = sideSubdivisions + 1;
+	const unsigned int vertexCount = NbVertexBySide * NbVertexBySide;
+	const unsigned int indiceCount = sideSubdivisions * sideSubdivisions * 6;
+
+	std::vector<glm::vec3> vertices(vertexCount);
+	std::vector<glm::vec3> normals(vertexCount, glm::vec3(0.f, 1.f, 0.f));
+	std::vector<unsigned int> indices(indiceCount);
+
+	const float fStep = 1.f / sideSubdivisions;
+	for (unsigned int iVertexX = 0; iVertexX < NbVertexBySide; ++iVertexX) {
+		for (unsigned int iVertexZ = 0; iVertexZ < NbVertexBySide; ++iVertexZ) {
+			unsigned int Indice = iVertexX * NbVertexBySide + iVertexZ;
+			vertices[Indice] = { -0.5f + iVertexX * fStep, 0.f, -0.5f + iVertexZ * fStep };
+		}
+	}
+
+	for (unsigned int iSquareX = 0; iSquareX < sideSubdivisions; ++iSquareX) {
+		for (unsigned int iSquareY = 0; iSquareY < sideSubdivisions; ++iSquareY) {
+			unsigned int iVertexStart = iSquareX * NbVertexBySide + iSquareY;
+			unsigned int iIndiceStart = (iSquareX * sideSubdivisions + iSquareY) * 6;
+			indices[iIndiceStart + 0] = iVertexStart;
+			indices[iIndiceStart + 1] = iVertexStart + 1;
+			indices[iIndiceStart + 2] = iVertexStart + NbVertexBySide + 1;
+			indices[iIndiceStart + 3] = iVertexStart;
+			indices[iIndiceStart + 4] = iVertexStart + NbVertexBySide + 1;
+			indices[iIndiceStart + 5] = iVertexStart + NbVertexBySide;
+		}
+	}
+
+	return addMesh(cache, key, vertices, normals, indices);
+}
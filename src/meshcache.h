@@ -0,0 +1,38 @@
+#pragma once
+
+#include "drawbuffer.h"
+
+#include <stdint.h>
+#include <unordered_map>
+
+// Unit meshes of the RenderApi3D primitives, built on first use and drawn with a model matrix.
+// Stored with half float positions and packed normals and colors (eVertexFormat3D::PackedHalf).
+// Apart from the axis, meshes have no color array: the draw color alone gives their color.
+struct MeshCache {
+	std::unordered_map<uint64_t, Buffer3D> meshes;
+	std::unordered_map<GLuint, GLuint> instancedVaos; // mesh vao -> vao with per-instance attributes
+	GLuint defaultVertexBuffer = 0;		// RenderEngine::defaultVertexBuffer3D, set before the first mesh
+};
+
+void deleteMeshCache(MeshCache& cache);
+
+// vertex array drawing mesh with one InstanceData3D per instance read from instanceBuffer
+GLuint getInstancedVertexArray(MeshCache& cache, const Buffer3D& mesh, GLuint instanceBuffer);
+
+// radius 1, centered on the origin
+const Buffer3D& getSphereMesh(MeshCache& cache, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions);
+
+// size 1, centered on the origin
+const Buffer3D& getCubeMesh(MeshCache& cache);
+
+// from the origin to (0, 0, 1)
+const Buffer3D& getBoneMesh(MeshCache& cache);
+
+// lines, size 1 on the XZ plane, centered on the origin
+const Buffer3D& getGridMesh(MeshCache& cache, unsigned int subdivisions);
+
+// lines, red X, green Y and blue Z of length 1
+const Buffer3D& getAxisMesh(MeshCache& cache);
+
+// size 1 on the XZ plane, centered on the origin
+const Buffer3D& getPlaneMesh(MeshCache& cache, unsigned int sideSubdivisions);
@@ -0,0 +1,72 @@
+#include "meshpool.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+MeshHandle createPoolMesh(MeshPool& pool, const CreateBuffer3DParams& params) {
+	uint32_t index;
+	if (!pool.freeSlots.empty()) {
+		index = pool.freeSlots.back();
+		pool.freeSlots.pop_back();
+	}
+	else {
+		index = (uint32_t)pool.slots.size();
+		pool.slots.emplace_back();
+	}
+
+	MeshPool::Slot& slot = pool.slots[index];
+	assert(!slot.used);
+	createBuffer3D(slot.buffer, params);
+	slot.used = true;
+
+	MeshHandle handle;
+	handle.index = index;
+	handle.generation = slot.generation;
+	return handle;
+}
+
+void deletePoolMesh(MeshPool& pool, MeshHandle handle) {
+	if (!getPoolMesh(pool, handle)) {
+		fprintf(stderr, "Trying to delete an invalid mesh handle\n");
+		return;
+	}
+
+	MeshPool::Slot& slot = pool.slots[handle.index];
+	slot.used = false;
+	++slot.generation;
+	if (slot.generation == 0) {
+		slot.generation = 1;
+	}
+	pool.pendingDeletes.push_back(handle.index);
+}
+
+Buffer3D* getPoolMesh(MeshPool& pool, MeshHandle handle) {
+	if (handle.index >= pool.slots.size()) {
+		return nullptr;
+	}
+	MeshPool::Slot& slot = pool.slots[handle.index];
+	if (!slot.used || slot.generation != handle.generation) {
+		return nullptr;
+	}
+	return &slot.buffer;
+}
+
+void collectMeshPool(MeshPool& pool) {
+	for (uint32_t index : pool.pendingDeletes) {
+		deleteBuffer3D(pool.slots[index].buffer);
+		pool.slots[index].buffer = Buffer3D();
+		pool.freeSlots.push_back(index);
+	}
+	pool.pendingDeletes.clear();
+}
+
+void deleteMeshPool(MeshPool& pool) {
+	for (MeshPool::Slot& slot : pool.slots) {
+		if (slot.used) {
+			deleteBuffer3D(slot.buffer);
+		}
+	}
+	collectMeshPool(pool);
+	pool.slots.clear();
+	pool.freeSlots.clear();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "drawbuffer.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Handle to a mesh owned by a MeshPool, stays invalid once the mesh is deleted.
+// Generation 0 is never used, a default constructed handle is invalid.
+struct MeshHandle {
+	uint32_t index = 0;
+	uint32_t generation = 0;
+};
+
+// Retained meshes created by the user code, kept alive until deleted.
+// Deletions are deferred to the end of the frame because recorded draws may still use the mesh.
+struct MeshPool {
+	struct Slot {
+		Buffer3D buffer;
+		uint32_t generation = 1;
+		bool used = false;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<uint32_t> pendingDeletes;
+};
+
+MeshHandle createPoolMesh(MeshPool& pool, const CreateBuffer3DParams& params);
+
+// the handle is invalid right away, the buffer is deleted by collectMeshPool
+void deletePoolMesh(MeshPool& pool, MeshHandle handle);
+
+// nullptr when the handle is invalid
+Buffer3D* getPoolMesh(MeshPool& pool, MeshHandle handle);
+
+// deletes the meshes released during the frame, call once the frame draws are submitted
+void collectMeshPool(MeshPool& pool);
+
+void deleteMeshPool(MeshPool& pool);
@@ -0,0 +1,72 @@
+#include "radixsort.h"
+
+#include <string.h>
+
+namespace {
+	constexpr unsigned int DigitBits = 8;
+	constexpr unsigned int DigitCount = 1 << DigitBits;
+	constexpr unsigned int PassCount = (32 + DigitBits - 1) / DigitBits;
+
+	uint32_t getDigit(uint32_t key, unsigned int pass) {
+		return (key >> (pass * DigitBits)) & (DigitCount - 1);
+	}
+}
+
+void radixSort(RadixSortBuffer& buffer) {
+	const size_t count = buffer.keys.size();
+	if (count < 2) {
+		return;
+	}
+	buffer.tempKeys.resize(count);
+	buffer.tempValues.resize(count);
+
+	// the histograms of every pass are built with a single read of the keys
+	uint32_t histograms[PassCount][DigitCount];
+	memset(histograms, 0, sizeof(histograms));
+	uint32_t const* pKeys = buffer.keys.data();
+	for (size_t i = 0; i < count; ++i) {
+		const uint32_t key = pKeys[i];
+		for (unsigned int pass = 0; pass < PassCount; ++pass) {
+			++histograms[pass][getDigit(key, pass)];
+		}
+	}
+
+	uint32_t* pSourceKeys = buffer.keys.data();
+	uint32_t* pSourceValues = buffer.values.data();
+	uint32_t* pDestKeys = buffer.tempKeys.data();
+	uint32_t* pDestValues = buffer.tempValues.data();
+	for (unsigned int pass = 0; pass < PassCount; ++pass) {
+		uint32_t* histogram = histograms[pass];
+		if (histogram[getDigit(pSourceKeys[0], pass)] == count) {
+			continue;
+		}
+
+		// histogram to the first destination index of each digit
+		uint32_t offset = 0;
+		for (unsigned int digit = 0; digit < DigitCount; ++digit) {
+			const uint32_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			const uint32_t key = pSourceKeys[i];
+			const uint32_t index = histogram[getDigit(key, pass)]++;
+			pDestKeys[index] = key;
+			pDestValues[index] = pSourceValues[i];
+		}
+
+		uint32_t* pSwap = pSourceKeys;
+		pSourceKeys = pDestKeys;
+		pDestKeys = pSwap;
+		pSwap = pSourceValues;
+		pSourceValues = pDestValues;
+		pDestValues = pSwap;
+	}
+
+	// the sorted keys end up in the temp arrays after an odd number of passes, some being skipped
+	if (pSourceKeys != buffer.keys.data()) {
+		buffer.keys.swap(buffer.tempKeys);
+		buffer.values.swap(buffer.tempValues);
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// 32-bit keys sorted in increasing order with their values, the sort is stable.
+// temp memory is kept between sorts.
+struct RadixSortBuffer {
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> values;
+	std::vector<uint32_t> tempKeys;
+	std::vector<uint32_t> tempValues;
+};
+
+// four passes of 8 bits, the histograms fit in L1, the passes whose digit is the same for every key are skipped
+void radixSort(RadixSortBuffer& buffer);
+
+// key sorting the floats in increasing order, ~key sorts them in decreasing order
+inline uint32_t getRadixKey(float value) {
+	union {
+		float f;
+		uint32_t u;
+	} bits;
+	bits.f = value;
+	// negative floats have every bit flipped so that they sort backward, positive floats only the sign bit
+	const uint32_t mask = uint32_t(-int32_t(bits.u >> 31)) | 0x80000000u;
+	return bits.u ^ mask;
+}
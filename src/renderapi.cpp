@@ -1,491 +1,684 @@
 #include "renderapi.h"
 #include "renderengine.h"
 #include "drawbuffer.h"
+#include "streambuffer.h"
+#include "drawlist.h"
+#include "meshcache.h"
+#include "frustum.h"
+#include "lod.h"
+#include "radixsort.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/common.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
 
 #define COUNTOF(ARRAY) (sizeof(ARRAY) / sizeof(ARRAY[0]))
 
 namespace {
-	struct DUMMY_STACKED_ALLOCATOR {
-		enum { MAX_SIZE = 16 * 1024 * 1024};
-		char* pCurrent;
-		int SizeInUse;
-		DUMMY_STACKED_ALLOCATOR() {
-			pCurrent = new char[MAX_SIZE];
-		}
-		void* Allocate(int Size) {
-			assert(SizeInUse + Size < MAX_SIZE);
-			char* pToReturn = pCurrent;
-			pCurrent += Size + 4;
-			*(int*)pToReturn = Size + 4;
-			SizeInUse += Size + 4;
-			return (void*)(pToReturn + 4);
-		}
-		void Free(void* pPointer) {
-			assert(pPointer < pCurrent);
-			int* pSize = (int*)pPointer;
-			--pSize;
-			SizeInUse -= *pSize;
-			pCurrent = (char*)pSize;
+	// the custom pass draws with the permutation picked by RenderApi3D::customShader
+	ShaderProgram& getShader3D(const RenderApi3D& api) {
+		return api.pRenderEngine->pCustomShader3D ? *api.pRenderEngine->pCustomShader3D : *api.pShader3D;
+	}
+
+	// counts the test in the frame stats, everything is visible when culling is off
+	bool isVisible(RenderEngine& engine, const glm::vec4& worldSphere) {
+		if (!engine.frustumCulling3D) {
+			return true;
 		}
-	};
-	DUMMY_STACKED_ALLOCATOR Allocator;
-}
+		if (testSphere(engine.frustum3D, worldSphere)) {
+			++engine.stats.visibleObjects3D;
+			return true;
+		}
+		++engine.stats.culledObjects3D;
+		return false;
+	}
 
-void RenderApi3D::buffer(const Buffer3D& buffer, eDrawMode drawMode, glm::mat4 const* pModel) const {
-	glm::mat4 model = pModel ? *pModel : glm::identity<glm::mat4>();
-	glProgramUniformMatrix4fv(pShader3D->programId, pShader3D->modelLocation, 1, 0, glm::value_ptr(model));
+	// tests the first count spheres of engine.cullSpheres, engine.cullVisibility tells which ones are visible
+	unsigned int cullInstances(RenderEngine& engine, unsigned int count) {
+		engine.cullVisibility.resize(count);
+		if (!engine.frustumCulling3D) {
+			memset(engine.cullVisibility.data(), 1, count);
+			return count;
+		}
+		const unsigned int visibleCount = testSpheres(engine.frustum3D, engine.cullSpheres.data(), count, engine.cullVisibility.data());
+		engine.stats.visibleObjects3D += visibleCount;
+		engine.stats.culledObjects3D += count - visibleCount;
+		return visibleCount;
+	}
 
-	const bool lightingEnabled = buffer.vbos[Buffer3D::BufferAttribNormal] != 0;
-	glProgramUniform1i(pShader3D->programId, pShader3D->lightingEnabledLocation, lightingEnabled);
+	// LOD level of a sphere from its radius in pixels, the highest one when the camera is inside
+	unsigned int getSphereLodLevel(const RenderEngine& engine, const glm::vec3& center, float radius) {
+		const float distance = glm::length(center - engine.cameraPosition);
+		if (distance <= radius) {
+			return LodLevelCount - 1;
+		}
+		return getLodLevel(radius * engine.lodPixelScale / distance);
+	}
 
-	assert(buffer.vao); // did you call createDrawBuffer3D ?
-	glBindVertexArray(buffer.vao);
-	if (buffer.ibo != 0) {
-		glDrawElements((GLenum)drawMode, buffer.indexCount, GL_UNSIGNED_INT, nullptr);
+	// view space depth, transparent draws are sorted back to front on it
+	float getViewDepth(const RenderEngine& engine, const glm::vec3& position) {
+		return glm::dot(position - engine.cameraPosition, engine.cameraDirection);
 	}
-	else {
-		glDrawArrays((GLenum)drawMode, 0, buffer.vertexCount);
+
+	// draws with a color alpha below 1 go to the transparent pass, sorted on the depth of their center
+	void setTransparency(const RenderEngine& engine, DrawCommand3D& command, const glm::vec4& worldSphere) {
+		command.transparent = command.color.a < 1.f;
+		command.depth = getViewDepth(engine, glm::vec3(worldSphere));
 	}
-	glBindVertexArray(0);
-}
 
-void RenderApi3D::lines(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel) const {
-	glm::vec4* colors = (glm::vec4 * )Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
+	// world space sphere around the vertices
+	glm::vec4 getVerticesBoundingSphere(glm::vec3 const* vertices, unsigned int vertexCount, glm::mat4 const* pModel) {
+		glm::vec3 boundsMin = vertices[0];
+		glm::vec3 boundsMax = vertices[0];
+		for (unsigned int i = 1; i < vertexCount; ++i) {
+			boundsMin = glm::min(boundsMin, vertices[i]);
+			boundsMax = glm::max(boundsMax, vertices[i]);
+		}
+		const glm::vec4 sphere = getBoundingSphere(boundsMin, boundsMax);
+		return pModel ? transformBoundingSphere(sphere, *pModel) : sphere;
+	}
+
+	// immediate-mode geometry written straight into the mapped stream buffer
+	template<typename Vertex>
+	struct StreamAllocation {
+		Vertex* pVertices = nullptr;
+		unsigned int* pIndices = nullptr;
+		GLint firstVertex = 0;
+		GLintptr indexOffset = 0;
+	};
+
+	template<typename Vertex>
+	bool allocateStream(RenderEngine& engine, GLsizei vertexCount, GLsizei indexCount, StreamAllocation<Vertex>& allocation) {
+		GLintptr vertexOffset;
+		allocation.pVertices = (Vertex*)allocateStreamBuffer(engine.streamBuffer, vertexCount * sizeof(Vertex), sizeof(Vertex), vertexOffset);
+		if (!allocation.pVertices) {
+			fprintf(stderr, "Stream buffer is full, primitive skipped\n");
+			return false;
+		}
+		allocation.firstVertex = GLint(vertexOffset / sizeof(Vertex));
+
+		if (indexCount > 0) {
+			allocation.pIndices = (unsigned int*)allocateStreamBuffer(engine.streamBuffer, indexCount * sizeof(unsigned int), sizeof(unsigned int), allocation.indexOffset);
+			if (!allocation.pIndices) {
+				fprintf(stderr, "Stream buffer is full, primitive skipped\n");
+				return false;
+			}
+		}
+		return true;
 	}
 
-	Buffer3D buffer3D;
+	template<typename Vertex>
+	void drawStream(const RenderApi3D& api, eStreamLayout3D layout, eDrawMode drawMode, const StreamAllocation<Vertex>& allocation, GLsizei vertexCount, GLsizei indexCount, glm::mat4 const* pModel, const glm::vec4& worldSphere, const glm::vec4& color) {
+		DrawCommand3D command;
+		command.vao = api.pRenderEngine->streamVaos3D[(int)layout];
+		command.drawMode = (GLenum)drawMode;
+		command.firstVertex = allocation.firstVertex;
+		command.lightingEnabled = layout == eStreamLayout3D::PositionNormalColor;
+		if (indexCount > 0) {
+			command.indexed = true;
+			command.indexOffset = allocation.indexOffset;
+			command.count = indexCount;
+		}
+		else {
+			command.count = vertexCount;
+		}
+		command.color = color;
+		setTransparency(*api.pRenderEngine, command, worldSphere);
+		recordDrawCommand3D(api.pRenderEngine->drawList3D, api.pRenderEngine->glState, api.pRenderEngine->streamBuffer, getShader3D(api), command, pModel);
+	}
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = nullptr;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+	// the buffer is culled on its bounds unless pWorldSphere gives tighter ones
+	void recordBuffer(const RenderApi3D& api, const Buffer3D& buffer, eDrawMode drawMode, glm::mat4 const* pModel, const glm::vec4& color, glm::vec4 const* pWorldSphere = nullptr) {
+		assert(buffer.vao); // did you call createDrawBuffer3D ?
 
-	buffer(buffer3D, eDrawMode::Lines, pModel);
+		glm::vec4 worldSphere;
+		if (pWorldSphere) {
+			worldSphere = *pWorldSphere;
+		}
+		else {
+			worldSphere = getBoundingSphere(buffer.boundsMin, buffer.boundsMax);
+			if (pModel) {
+				worldSphere = transformBoundingSphere(worldSphere, *pModel);
+			}
+		}
+		if (!isVisible(*api.pRenderEngine, worldSphere)) {
+			return;
+		}
 
-	deleteBuffer3D(buffer3D);
+		DrawCommand3D command;
+		command.vao = buffer.vao;
+		command.drawMode = (GLenum)drawMode;
+		command.lightingEnabled = buffer.hasNormals;
+		if (buffer.ibo != 0) {
+			command.indexed = true;
+			command.count = buffer.indexCount;
+		}
+		else {
+			command.count = buffer.vertexCount;
+		}
+		command.color = color;
+		setTransparency(*api.pRenderEngine, command, worldSphere);
+		recordDrawCommand3D(api.pRenderEngine->drawList3D, api.pRenderEngine->glState, api.pRenderEngine->streamBuffer, getShader3D(api), command, pModel);
+	}
 
-	Allocator.Free(colors);
-}
+	// instance data is aligned on its own size so that the offset in the stream buffer gives the base instance
+	InstanceData3D* allocateInstances(RenderEngine& engine, unsigned int count, GLuint& baseInstance) {
+		GLintptr offset;
+		InstanceData3D* pInstances = (InstanceData3D*)allocateStreamBuffer(engine.streamBuffer, count * sizeof(InstanceData3D), sizeof(InstanceData3D), offset);
+		if (!pInstances) {
+			fprintf(stderr, "Stream buffer is full, instances skipped\n");
+			return nullptr;
+		}
+		baseInstance = GLuint(offset / sizeof(InstanceData3D));
+		return pInstances;
+	}
 
-void RenderApi3D::grid(float size, unsigned int subdivisions, const glm::vec4& color, glm::mat4 const* pModel) const {
-	subdivisions = glm::max(subdivisions, 1u);
+	// pDepth is the depth of the farthest instance for a transparent draw, null for an opaque one
+	void recordInstanceDraw(const RenderApi3D& api, const Buffer3D& mesh, GLuint baseInstance, unsigned int count, float const* pDepth) {
+		RenderEngine& engine = *api.pRenderEngine;
+
+		DrawCommand3D command;
+		command.vao = getInstancedVertexArray(engine.meshCache, mesh, engine.streamBuffer.bufferId);
+		command.drawMode = GL_TRIANGLES;
+		command.lightingEnabled = mesh.hasNormals;
+		command.indexed = mesh.ibo != 0;
+		command.count = command.indexed ? mesh.indexCount : mesh.vertexCount;
+		command.instanceCount = (GLsizei)count;
+		command.baseInstance = baseInstance;
+		if (pDepth) {
+			command.transparent = true;
+			command.depth = *pDepth;
+		}
+		recordDrawCommand3D(engine.drawList3D, engine.glState, engine.streamBuffer, getShader3D(api), command, nullptr);
+	}
 
-	const unsigned int lineCount = 4 + 2 * (subdivisions - 1);
-	const unsigned int vertexCount = 2 * lineCount;
-	glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
+	void writeInstance(InstanceData3D& instance, const SphereInstance& sphere) {
+		instance.rotation = glm::vec4(0.f, 0.f, 0.f, 1.f);
+		instance.positionScale = glm::vec4(sphere.center, sphere.radius);
+		instance.color = sphere.color;
+	}
 
-	const float halfSize = 0.5f * size;
+	void writeInstance(InstanceData3D& instance, const CubeInstance& cube) {
+		instance.rotation = glm::vec4(0.f, 0.f, 0.f, 1.f);
+		instance.positionScale = glm::vec4(cube.center, cube.size);
+		instance.color = cube.color;
+	}
 
-	int iVertex = 0;
+	void writeInstance(InstanceData3D& instance, const BoneInstance& bone) {
+		const float length = glm::length(bone.childRelativePosition);
 
-	vertices[iVertex++] = glm::vec3(-halfSize, 0.f, halfSize);
-	vertices[iVertex++] = glm::vec3(halfSize, 0.f, halfSize);
-	vertices[iVertex++] = glm::vec3(-halfSize, 0.f, -halfSize);
-	vertices[iVertex++] = glm::vec3(halfSize, 0.f, -halfSize);
-	vertices[iVertex++] = glm::vec3(-halfSize, 0.f, halfSize);
-	vertices[iVertex++] = glm::vec3(-halfSize, 0.f, -halfSize);
-	vertices[iVertex++] = glm::vec3(halfSize, 0.f, halfSize);
-	vertices[iVertex++] = glm::vec3(halfSize, 0.f, -halfSize);
+		glm::vec3 front = glm::normalize(bone.childRelativePosition);
+		glm::vec3 left;
+		glm::vec3 up;
+		const float frontDot = glm::dot(front, glm::vec3(0.f, 1.f, 0.f));
+		if (glm::abs(frontDot) != 1.f) {
+			left = glm::normalize(glm::cross(glm::vec3(0.f, 1.f, 0.f), front));
+			up = glm::normalize(glm::cross(front, left));
+		}
+		else {
+			up = glm::normalize(glm::cross(front, glm::vec3(1.f, 0.f, 0.f)));
+			left = glm::normalize(glm::cross(up, front));
+		}
 
-	for (unsigned int i = 1; i < subdivisions; ++i) {
-		const float coord = -halfSize + size * (i / float(subdivisions));
-		vertices[iVertex++] = glm::vec3(coord, 0.f, -halfSize);
-		vertices[iVertex++] = glm::vec3(coord, 0.f, halfSize);
-		vertices[iVertex++] = glm::vec3(-halfSize, 0.f, coord);
-		vertices[iVertex++] = glm::vec3(halfSize, 0.f, coord);
+		// same placement as bone(), the orthonormal basis folds into the rotation and the length into the scale
+		const glm::quat rotation = bone.parentAbsoluteRotation * glm::quat_cast(glm::mat3(left, up, front));
+		instance.rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+		instance.positionScale = glm::vec4(bone.parentAbsolutePosition, length);
+		instance.color = bone.color;
 	}
 
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
+	// counts the visible instances of each LOD level (engine.lodLevels), the opaque and the transparent ones apart,
+	// and sorts the visible transparent ones back to front on the depth of their bounding sphere (engine.cullSpheres)
+	template<typename Instance>
+	void sortInstances(RenderEngine& engine, Instance const* instances, unsigned int count, unsigned int* opaqueCounts, unsigned int* transparentCounts) {
+		RadixSortBuffer& sort = engine.instanceSort;
+		sort.keys.clear();
+		sort.values.clear();
+		for (unsigned int i = 0; i < count; ++i) {
+			if (!engine.cullVisibility[i]) {
+				continue;
+			}
+			if (instances[i].color.a < 1.f) {
+				sort.keys.push_back(~getRadixKey(getViewDepth(engine, glm::vec3(engine.cullSpheres[i]))));
+				sort.values.push_back(i);
+				++transparentCounts[engine.lodLevels[i]];
+			}
+			else {
+				++opaqueCounts[engine.lodLevels[i]];
+			}
+		}
+		radixSort(sort);
 	}
 
+	// one draw for the opaque instances of the level in submission order, one transparent draw for the others back to front
+	template<typename Instance>
+	void recordInstances(const RenderApi3D& api, const Buffer3D& mesh, Instance const* instances, unsigned int count, uint8_t level, unsigned int opaqueCount, unsigned int transparentCount) {
+		RenderEngine& engine = *api.pRenderEngine;
+
+		GLuint baseInstance;
+		if (opaqueCount > 0) {
+			InstanceData3D* pInstances = allocateInstances(engine, opaqueCount, baseInstance);
+			if (!pInstances) {
+				return;
+			}
+			for (unsigned int i = 0; i < count; ++i) {
+				if (engine.cullVisibility[i] && engine.lodLevels[i] == level && instances[i].color.a >= 1.f) {
+					writeInstance(*pInstances++, instances[i]);
+				}
+			}
+			recordInstanceDraw(api, mesh, baseInstance, opaqueCount, nullptr);
+		}
 
+		if (transparentCount > 0) {
+			InstanceData3D* pInstances = allocateInstances(engine, transparentCount, baseInstance);
+			if (!pInstances) {
+				return;
+			}
+			float depth = 0.f;
+			bool first = true;
+			for (uint32_t i : engine.instanceSort.values) {
+				if (engine.lodLevels[i] != level) {
+					continue;
+				}
+				if (first) {
+					depth = getViewDepth(engine, glm::vec3(engine.cullSpheres[i]));
+					first = false;
+				}
+				writeInstance(*pInstances++, instances[i]);
+			}
+			recordInstanceDraw(api, mesh, baseInstance, transparentCount, &depth);
+		}
+	}
 
-	Buffer3D buffer3D;
+	// a buffer without colors reads white from the default vertex
+	void drawBuffer2D(RenderEngine& engine, const Buffer2D& buffer, eDrawMode drawMode) {
+		assert(buffer.vao); // did you call createDrawBuffer2D ?
+		bindVertexArray(engine.glState, buffer.vao);
+		glDrawArrays((GLenum)drawMode, 0, buffer.vertexCount);
+	}
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = nullptr;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+	// shapes go to the 2D overlay list, drawn at the end of the 2D pass
+	void appendVertices2D(RenderEngine& engine, glm::vec2 const* vertices, unsigned int vertexCount, eDrawMode drawMode, const glm::vec4& color) {
+		assert(drawMode == eDrawMode::Triangles || drawMode == eDrawMode::Lines);
+		StreamVertex2D* pVertices = drawMode == eDrawMode::Triangles ? appendTriangles2D(engine.drawList2D, vertexCount) : appendLines2D(engine.drawList2D, vertexCount);
+		const uint32_t packedColor = packVertexColor(color);
+		for (unsigned int i = 0; i < vertexCount; ++i) {
+			pVertices[i].position = vertices[i];
+			pVertices[i].color = packedColor;
+		}
+	}
 
-	buffer(buffer3D, eDrawMode::Lines, pModel);
+	// one quad around the shape with a pixel of margin for the antialiasing, axis is the unit direction of local x
+	void appendShape2D(RenderEngine& engine, const glm::vec2& center, const glm::vec2& axis, const glm::vec2& halfSize, float cornerRadius, float thickness, const glm::vec4& color) {
+		const glm::vec2 ortho = { -axis.y, axis.x };
+		const glm::vec2 extent = halfSize + 1.f;
+		const glm::vec2 corners[] = {
+			{ -extent.x, -extent.y },
+			{ extent.x, -extent.y },
+			{ extent.x, extent.y },
+			{ -extent.x, -extent.y },
+			{ extent.x, extent.y },
+			{ -extent.x, extent.y },
+		};
 
-	deleteBuffer3D(buffer3D);
+		StreamShape2D* pVertices = appendShapes2D(engine.drawList2D, 1);
+		const uint32_t packedColor = packVertexColor(color);
+		const glm::vec4 shape = glm::vec4(halfSize, glm::min(cornerRadius, glm::min(halfSize.x, halfSize.y)), thickness);
+		for (const glm::vec2& corner : corners) {
+			pVertices->position = center + axis * corner.x + ortho * corner.y;
+			pVertices->color = packedColor;
+			pVertices->local = corner;
+			pVertices->shape = shape;
+			++pVertices;
+		}
+	}
+}
 
-	Allocator.Free(colors);
-	Allocator.Free(vertices);
+void RenderApi3D::buffer(const Buffer3D& buffer, eDrawMode drawMode, glm::mat4 const* pModel) const {
+	recordBuffer(*this, buffer, drawMode, pModel, glm::vec4(1.f));
 }
 
-void RenderApi3D::axisXYZ(glm::mat4 const* pModel) const {
-	glm::vec3 vertices[] = {
-		glm::vec3(0.f, 0.f, 0.f),
-		glm::vec3(1.f, 0.f, 0.f),
-		glm::vec3(0.f, 0.f, 0.f),
-		glm::vec3(0.f, 1.f, 0.f),
-		glm::vec3(0.f, 0.f, 0.f),
-		glm::vec3(0.f, 0.f, 1.f),
-	};
-	constexpr size_t vertexCount = COUNTOF(vertices);
-
-	glm::vec4 colors[] = {
-		glm::vec4(1.f, 0.f, 0.f, 1.f),
-		glm::vec4(1.f, 0.f, 0.f, 1.f),
-		glm::vec4(0.f, 1.f, 0.f, 1.f),
-		glm::vec4(0.f, 1.f, 0.f, 1.f),
-		glm::vec4(0.f, 0.f, 1.f, 1.f),
-		glm::vec4(0.f, 0.f, 1.f, 1.f),
-	};
+void RenderApi3D::lines(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel) const {
+	if (vertexCount == 0) {
+		return;
+	}
+	const glm::vec4 worldSphere = getVerticesBoundingSphere(vertices, vertexCount, pModel);
+	if (!isVisible(*pRenderEngine, worldSphere)) {
+		return;
+	}
 
-	Buffer3D buffer3D;
+	StreamAllocation<glm::vec3> allocation;
+	if (!allocateStream(*pRenderEngine, vertexCount, 0, allocation)) {
+		return;
+	}
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = nullptr;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+	memcpy(allocation.pVertices, vertices, vertexCount * sizeof(glm::vec3));
 
-	buffer(buffer3D, eDrawMode::Lines, pModel);
+	drawStream(*this, eStreamLayout3D::Position, eDrawMode::Lines, allocation, vertexCount, 0, pModel, worldSphere, color);
+}
 
-	deleteBuffer3D(buffer3D);
+void RenderApi3D::lineStrip(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel, float width) const {
+	lineStrips(vertices, &vertexCount, 1, color, pModel, width);
 }
 
-void RenderApi3D::solidCube(float size, const glm::vec4& color, glm::mat4 const* pModel) const {
-	const float halfsize = size * 0.5f;
-	glm::vec3 edges[8] =
-	{
-		{ -halfsize, -halfsize, -halfsize},
-		{ +halfsize, -halfsize, -halfsize},
-		{ +halfsize, +halfsize, -halfsize},
-		{ -halfsize, +halfsize, -halfsize},
-		{ -halfsize, -halfsize, +halfsize},
-		{ +halfsize, -halfsize, +halfsize},
-		{ +halfsize, +halfsize, +halfsize},
-		{ -halfsize, +halfsize, +halfsize},
-	};
+void RenderApi3D::lineStrips(glm::vec3 const* vertices, unsigned int const* stripVertexCounts, unsigned int stripCount, const glm::vec4& color, glm::mat4 const* pModel, float width) const {
+	RenderEngine& engine = *pRenderEngine;
 
-	glm::vec3 faceNormals[6] =
-	{
-		{ 0, 0, -1 },
-		{ +1, 0, 0 },
-		{ 0, 0, +1 },
-		{ -1, 0, 0 },
-		{ 0, +1, 0 },
-		{ 0, -1, 0 },
-	};
+	unsigned int vertexCount = 0;
+	for (unsigned int iStrip = 0; iStrip < stripCount; ++iStrip) {
+		vertexCount += stripVertexCounts[iStrip];
+	}
+	if (vertexCount < 2) {
+		return;
+	}
+	const glm::vec4 worldSphere = getVerticesBoundingSphere(vertices, vertexCount, pModel);
+	if (!isVisible(engine, worldSphere)) {
+		return;
+	}
 
-	int indices[36] =
-	{
-		0, 1, 3, 3, 1, 2,
-		1, 5, 2, 2, 5, 6,
-		5, 4, 6, 6, 4, 7,
-		4, 0, 7, 7, 0, 3,
-		3, 2, 7, 7, 2, 6,
-		4, 5, 0, 0, 5, 1
-	};
+	if (width > 0.f) {
+		// one instance per segment expanded to a quad in the vertex shader, a vertex with a negative width separates the strips
+		const unsigned int streamVertexCount = vertexCount + stripCount - 1;
+		StreamAllocation<glm::vec4> allocation;
+		if (!allocateStream(engine, streamVertexCount, 0, allocation)) {
+			return;
+		}
+		glm::vec4* pVertex = allocation.pVertices;
+		glm::vec3 const* pSource = vertices;
+		for (unsigned int iStrip = 0; iStrip < stripCount; ++iStrip) {
+			if (iStrip > 0) {
+				*pVertex++ = glm::vec4(0.f, 0.f, 0.f, -1.f);
+			}
+			for (unsigned int i = 0; i < stripVertexCounts[iStrip]; ++i) {
+				*pVertex++ = glm::vec4(*pSource++, width);
+			}
+		}
 
-	constexpr size_t vertexCount = 36;
-	float vertices[3 * vertexCount];
-	for (int i = 0; i < 36; i++) {
-		vertices[i * 3 + 0] = edges[indices[i]].x;
-		vertices[i * 3 + 1] = edges[indices[i]].y;
-		vertices[i * 3 + 2] = edges[indices[i]].z;
+		DrawCommand3D command;
+		command.vao = engine.streamVaos3D[(int)eStreamLayout3D::LineSegment];
+		command.drawMode = GL_TRIANGLES;
+		command.count = 6;
+		command.instanceCount = GLsizei(streamVertexCount - 1);
+		command.baseInstance = GLuint(allocation.firstVertex);
+		command.color = color;
+		setTransparency(engine, command, worldSphere);
+		recordDrawCommand3D(engine.drawList3D, engine.glState, engine.streamBuffer, engine.shader3D_thickLine, command, pModel);
+		return;
 	}
 
-	float normals[3 * vertexCount];
-	for (int i = 0; i < 36; i++) {
-		normals[i * 3 + 0] = faceNormals[i / 6].x;
-		normals[i * 3 + 1] = faceNormals[i / 6].y;
-		normals[i * 3 + 2] = faceNormals[i / 6].z;
+	// strips separated by the primitive restart index
+	const unsigned int indexCount = vertexCount + stripCount - 1;
+	StreamAllocation<glm::vec3> allocation;
+	if (!allocateStream(engine, vertexCount, indexCount, allocation)) {
+		return;
 	}
-
-	glm::vec4 colors[vertexCount];
-	for (int iColor = 0; iColor < 6 * 6; ++iColor) {
-		colors[iColor] = color;
+	memcpy(allocation.pVertices, vertices, vertexCount * sizeof(glm::vec3));
+	unsigned int* pIndex = allocation.pIndices;
+	unsigned int index = 0;
+	for (unsigned int iStrip = 0; iStrip < stripCount; ++iStrip) {
+		if (iStrip > 0) {
+			*pIndex++ = 0xFFFFFFFF;
+		}
+		for (unsigned int i = 0; i < stripVertexCounts[iStrip]; ++i) {
+			*pIndex++ = index++;
+		}
 	}
 
-	Buffer3D buffer3D;
+	drawStream(*this, eStreamLayout3D::Position, eDrawMode::LineStrip, allocation, vertexCount, indexCount, pModel, worldSphere, color);
+}
+
+void RenderApi3D::grid(float size, unsigned int subdivisions, const glm::vec4& color, glm::mat4 const* pModel) const {
+	subdivisions = glm::max(subdivisions, 1u);
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = reinterpret_cast<glm::vec3*>(vertices);
-	createCubeBufferParams.pNormals = reinterpret_cast<glm::vec3*>(normals);
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+	const glm::mat4 model = (pModel ? *pModel : glm::identity<glm::mat4>()) * glm::scale(glm::identity<glm::mat4>(), glm::vec3(size));
+	recordBuffer(*this, getGridMesh(pRenderEngine->meshCache, subdivisions), eDrawMode::Lines, &model, color);
+}
 
-	buffer(buffer3D, eDrawMode::Triangles, pModel);
+void RenderApi3D::axisXYZ(glm::mat4 const* pModel) const {
+	recordBuffer(*this, getAxisMesh(pRenderEngine->meshCache), eDrawMode::Lines, pModel, glm::vec4(1.f));
+}
 
-	deleteBuffer3D(buffer3D);
+void RenderApi3D::solidCube(float size, const glm::vec4& color, glm::mat4 const* pModel) const {
+	const glm::mat4 model = (pModel ? *pModel : glm::identity<glm::mat4>()) * glm::scale(glm::identity<glm::mat4>(), glm::vec3(size));
+	recordBuffer(*this, getCubeMesh(pRenderEngine->meshCache), eDrawMode::Triangles, &model, color);
 }
 
 void RenderApi3D::solidSphere(const glm::vec3& center, float radius, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions, const glm::vec4& color) const {
+	if (horizontalSubdivisions == AutoSubdivisions) {
+		const unsigned int level = getSphereLodLevel(*pRenderEngine, center, radius);
+		horizontalSubdivisions = lodSubdivisions[level];
+		verticalSubdivisions = lodSubdivisions[level] / 2;
+	}
 	horizontalSubdivisions = glm::max(horizontalSubdivisions, 4u);
 	verticalSubdivisions = glm::max(verticalSubdivisions, 2u);
 
-	const int vertexCount = 2 + horizontalSubdivisions * (verticalSubdivisions - 1);
+	glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), center);
+	model = glm::scale(model, glm::vec3(radius));
+	const glm::vec4 worldSphere = glm::vec4(center, radius);
+	recordBuffer(*this, getSphereMesh(pRenderEngine->meshCache, horizontalSubdivisions, verticalSubdivisions), eDrawMode::Triangles, &model, color, &worldSphere);
+}
 
-	glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec3* normals = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
+void RenderApi3D::bone(const glm::vec3& childRelativePosition, const glm::vec4& color, const glm::quat& parentAbsoluteRotation, const glm::vec3& parentAbsolutePosition) const {
+	const float length = glm::length(childRelativePosition);
 
-	int iVertex = 0;
+	glm::vec3 front = glm::normalize(childRelativePosition);
+	glm::vec3 left;
+	glm::vec3 up;
+	const float frontDot = glm::dot(front, glm::vec3(0.f, 1.f, 0.f));
+	if (glm::abs(frontDot) != 1.f) {
+		left = glm::normalize(glm::cross(glm::vec3(0.f, 1.f, 0.f), front));
+		up = glm::normalize(glm::cross(front, left));
+	}
+	else {
+		up = glm::normalize(glm::cross(front, glm::vec3(1.f, 0.f, 0.f)));
+		left = glm::normalize(glm::cross(up, front));
+	}
 
-	const float verticalStep = glm::pi<float>() / verticalSubdivisions;
-	const float horizontalStep = glm::two_pi<float>() / horizontalSubdivisions;
-	for (unsigned int i = 1; i < verticalSubdivisions; ++i) {
-		const float verticalAngle = glm::half_pi<float>() - i * verticalStep;
+	// the cached bone goes along Z with left on X and up on Y
+	const glm::mat4 boneBasis = glm::mat4(
+		glm::vec4(left * length, 0.f),
+		glm::vec4(up * length, 0.f),
+		glm::vec4(front * length, 0.f),
+		glm::vec4(0.f, 0.f, 0.f, 1.f));
+	const glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), parentAbsolutePosition) * glm::mat4_cast(parentAbsoluteRotation) * boneBasis;
 
-		const float xz = radius * glm::cos(verticalAngle);
-		const float y = radius * glm::sin(verticalAngle);
+	recordBuffer(*this, getBoneMesh(pRenderEngine->meshCache), eDrawMode::Triangles, &model, color);
+}
 
-		for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-			const float horizontalAngle = j * horizontalStep;
-			const float x = xz * glm::cos(horizontalAngle);
-			const float z = xz * glm::sin(horizontalAngle);
+void RenderApi3D::horizontalPlane(const glm::vec3& center, const glm::vec2& size, unsigned int SideSubdivision, const glm::vec4& color) const{
+	SideSubdivision = glm::max(SideSubdivision, 1u);
 
+	glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), center);
+	model = glm::scale(model, glm::vec3(size.x, 1.f, size.y));
+	recordBuffer(*this, getPlaneMesh(pRenderEngine->meshCache, SideSubdivision), eDrawMode::Triangles, &model, color);
+}
 
-			vertices[iVertex] = center + glm::vec3(x, y, z);
-			normals[iVertex] = glm::vec3(x / radius, y / radius, z / radius);
-			colors[iVertex] = color;
-			iVertex++;
-		}
+void RenderApi3D::solidSpheres(SphereInstance const* spheres, unsigned int count, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions) const {
+	if (count == 0) {
+		return;
 	}
 
-	vertices[iVertex] = center + glm::vec3(0.f, radius, 0.f);
-	normals[iVertex] = glm::vec3(0.f, 1.f, 0.f);
-	colors[iVertex] = color;
-	iVertex++;
-
-	vertices[iVertex] = center + glm::vec3(0.f, -radius, 0.f);
-	normals[iVertex] = glm::vec3(0.f, -1.f, 0.f);
-	colors[iVertex] = color;
-	iVertex++;
-
-	const unsigned int indexCount = (2 * horizontalSubdivisions + (verticalSubdivisions - 2) * horizontalSubdivisions * 2) * 3;
-	unsigned int* indices = (unsigned int*)Allocator.Allocate(sizeof(unsigned int) * indexCount);
-	
-	unsigned int iIndex = 0;
-	const int iFirstLine = 0;
-	for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-		indices[iIndex++] = vertexCount - 2;
-		indices[iIndex++] = iFirstLine + j;
-		indices[iIndex++] = iFirstLine + ((j + 1) % horizontalSubdivisions);
+	RenderEngine& engine = *pRenderEngine;
+	engine.cullSpheres.resize(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		engine.cullSpheres[i] = glm::vec4(spheres[i].center, spheres[i].radius);
+	}
+	const unsigned int visibleCount = cullInstances(engine, count);
+	if (visibleCount == 0) {
+		return;
 	}
 
-	for (unsigned int i = 0; i < verticalSubdivisions - 2; ++i) {
-		for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-			const unsigned int iA = (i * horizontalSubdivisions) + j;
-			const unsigned int iB = (i * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
-			const unsigned int iC = ((i + 1) * horizontalSubdivisions) + j;
-			const unsigned int iD = ((i + 1) * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
-			indices[iIndex++] = iA;
-			indices[iIndex++] = iC;
-			indices[iIndex++] = iD;
-			indices[iIndex++] = iA;
-			indices[iIndex++] = iD;
-			indices[iIndex++] = iB;
+	// one instanced draw per LOD level in use, a single level when the subdivisions are given
+	engine.lodLevels.resize(count);
+	if (horizontalSubdivisions == AutoSubdivisions) {
+		for (unsigned int i = 0; i < count; ++i) {
+			if (engine.cullVisibility[i]) {
+				engine.lodLevels[i] = (uint8_t)getSphereLodLevel(engine, spheres[i].center, spheres[i].radius);
+			}
 		}
 	}
-
-	const int iLastLine = (verticalSubdivisions - 2) * horizontalSubdivisions;
-	for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-		indices[iIndex++] = vertexCount - 1;
-		indices[iIndex++] = iLastLine + j;
-		indices[iIndex++] = iLastLine + ((j + 1) % horizontalSubdivisions);
+	else {
+		memset(engine.lodLevels.data(), 0, count);
 	}
+	unsigned int opaqueCounts[LodLevelCount] = {};
+	unsigned int transparentCounts[LodLevelCount] = {};
+	sortInstances(engine, spheres, count, opaqueCounts, transparentCounts);
 
-	Buffer3D buffer3D;
-
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = normals;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.pIndices = indices;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createCubeBufferParams.indexCount = indexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
-
-	buffer(buffer3D, eDrawMode::Triangles, nullptr);
-
-	deleteBuffer3D(buffer3D);
-
-	Allocator.Free(indices);
-	Allocator.Free(colors);
-	Allocator.Free(normals);
-	Allocator.Free(vertices);
+	for (unsigned int level = 0; level < LodLevelCount; ++level) {
+		if (opaqueCounts[level] + transparentCounts[level] == 0) {
+			continue;
+		}
+		const unsigned int levelHorizontalSubdivisions = horizontalSubdivisions == AutoSubdivisions ? lodSubdivisions[level] : glm::max(horizontalSubdivisions, 4u);
+		const unsigned int levelVerticalSubdivisions = horizontalSubdivisions == AutoSubdivisions ? lodSubdivisions[level] / 2 : glm::max(verticalSubdivisions, 2u);
+		recordInstances(*this, getSphereMesh(engine.meshCache, levelHorizontalSubdivisions, levelVerticalSubdivisions), spheres, count, (uint8_t)level, opaqueCounts[level], transparentCounts[level]);
+	}
 }
 
-void RenderApi3D::bone(const glm::vec3& childRelativePosition, const glm::vec4& color, const glm::quat& parentAbsoluteRotation, const glm::vec3& parentAbsolutePosition) const {
-	glm::vec3 newChildRelativePosition = childRelativePosition;
-
-	const float size = glm::length(childRelativePosition) / 10.f;
+void RenderApi3D::solidCubes(CubeInstance const* cubes, unsigned int count) const {
+	if (count == 0) {
+		return;
+	}
 
-	glm::vec3 front = glm::normalize(childRelativePosition);
-	glm::vec3 left;
-	glm::vec3 up;
-	const float frontDot = glm::dot(front, glm::vec3(0.f, 1.f, 0.f));
-	if (glm::abs(frontDot) != 1.f) {
-		left = glm::normalize(glm::cross(glm::vec3(0.f, 1.f, 0.f), front));
-		up = glm::normalize(glm::cross(front, left));
+	RenderEngine& engine = *pRenderEngine;
+	const Buffer3D& mesh = getCubeMesh(engine.meshCache);
+	const glm::vec4 meshSphere = getBoundingSphere(mesh.boundsMin, mesh.boundsMax);
+	engine.cullSpheres.resize(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		engine.cullSpheres[i] = glm::vec4(cubes[i].center + glm::vec3(meshSphere) * cubes[i].size, meshSphere.w * cubes[i].size);
 	}
-	else {
-		up = glm::normalize(glm::cross(front, glm::vec3(1.f, 0.f, 0.f)));
-		left = glm::normalize(glm::cross(up, front));
+	const unsigned int visibleCount = cullInstances(engine, count);
+	if (visibleCount == 0) {
+		return;
 	}
-	up *= size;
-	front *= size;
-	left *= size;
-
-	up = parentAbsoluteRotation * glm::vec4(up, 0.f);
-	left = parentAbsoluteRotation * glm::vec4(left, 0.f);
-	front = parentAbsoluteRotation * glm::vec4(front, 0.f);
-	newChildRelativePosition = parentAbsoluteRotation * glm::vec4(newChildRelativePosition, 0.f);
-
-	glm::vec3 edges[] = {
-		parentAbsolutePosition,
-		parentAbsolutePosition + up + front,
-		parentAbsolutePosition - up + front,
-		parentAbsolutePosition + left + front,
-		parentAbsolutePosition - left + front,
-		parentAbsolutePosition + newChildRelativePosition,
-	};
 
-	unsigned int indices[] = {
-		0, 1, 3,
-		0, 4, 1,
-		0, 3, 2,
-		0, 2, 4,
-		5, 3, 1,
-		5, 1, 4,
-		5, 2, 3,
-		5, 4, 2,
-	};
-	const unsigned int vertexCount = COUNTOF(indices);
+	engine.lodLevels.assign(count, 0);
+	unsigned int opaqueCount = 0;
+	unsigned int transparentCount = 0;
+	sortInstances(engine, cubes, count, &opaqueCount, &transparentCount);
+	recordInstances(*this, mesh, cubes, count, 0, opaqueCount, transparentCount);
+}
 
-	glm::vec3 vertices[vertexCount];
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		vertices[i] = edges[indices[i]];
+void RenderApi3D::bones(BoneInstance const* bones, unsigned int count) const {
+	if (count == 0) {
+		return;
 	}
 
-	glm::vec3 normals[vertexCount];
-	for (unsigned int i = 0; i < vertexCount; i += 3) {
-		glm::vec3 normal = glm::normalize(glm::cross(edges[indices[i + 1]] - edges[indices[i + 0]], edges[indices[i + 2]] - edges[indices[i + 0]]));
-		normals[i + 0] = normal;
-		normals[i + 1] = normal;
-		normals[i + 2] = normal;
+	// the cached bone goes along Z, its bounds scaled by the length are placed along the child direction
+	RenderEngine& engine = *pRenderEngine;
+	const Buffer3D& mesh = getBoneMesh(engine.meshCache);
+	const glm::vec4 meshSphere = getBoundingSphere(mesh.boundsMin, mesh.boundsMax);
+	engine.cullSpheres.resize(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		const BoneInstance& bone = bones[i];
+		const float length = glm::length(bone.childRelativePosition);
+		const glm::vec3 center = bone.parentAbsolutePosition + bone.parentAbsoluteRotation * (bone.childRelativePosition * meshSphere.z);
+		engine.cullSpheres[i] = glm::vec4(center, (meshSphere.w + glm::length(glm::vec2(meshSphere))) * length);
 	}
-
-	glm::vec4 colors[vertexCount];
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
+	const unsigned int visibleCount = cullInstances(engine, count);
+	if (visibleCount == 0) {
+		return;
 	}
 
-	Buffer3D buffer3D;
+	engine.lodLevels.assign(count, 0);
+	unsigned int opaqueCount = 0;
+	unsigned int transparentCount = 0;
+	sortInstances(engine, bones, count, &opaqueCount, &transparentCount);
+	recordInstances(*this, mesh, bones, count, 0, opaqueCount, transparentCount);
+}
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = normals;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+MeshHandle RenderApi3D::createMesh(const CreateBuffer3DParams& params) const {
+	CreateBuffer3DParams meshParams = params;
+	meshParams.defaultVertexBuffer = pRenderEngine->defaultVertexBuffer3D;
+	return createPoolMesh(pRenderEngine->meshPool, meshParams);
+}
 
-	buffer(buffer3D, eDrawMode::Triangles, nullptr);
+void RenderApi3D::updateMeshRange(MeshHandle mesh, const UpdateBuffer3DParams& params) const {
+	Buffer3D* pBuffer = getPoolMesh(pRenderEngine->meshPool, mesh);
+	if (!pBuffer) {
+		fprintf(stderr, "Trying to update an invalid mesh handle\n");
+		return;
+	}
+	updateBuffer3D(*pBuffer, params);
+}
 
-	deleteBuffer3D(buffer3D);
+void RenderApi3D::drawMesh(MeshHandle mesh, eDrawMode drawMode, const glm::vec4& color, glm::mat4 const* pModel) const {
+	Buffer3D const* pBuffer = getPoolMesh(pRenderEngine->meshPool, mesh);
+	if (!pBuffer) {
+		fprintf(stderr, "Trying to draw an invalid mesh handle\n");
+		return;
+	}
+	recordBuffer(*this, *pBuffer, drawMode, pModel, color);
 }
 
-void RenderApi3D::horizontalPlane(const glm::vec3& center, const glm::vec2& size, unsigned int SideSubdivision, const glm::vec4& color) const{
-	unsigned int NbVertexBySide = SideSubdivision + 1;
-	unsigned int vertexCount = NbVertexBySide * NbVertexBySide;
-	
-	glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec3* normals = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
-
-	unsigned int indiceCount = SideSubdivision * SideSubdivision * 6;
-	unsigned int* indices = (unsigned int*)Allocator.Allocate(sizeof(unsigned int) * indiceCount);
-
-	float fStepX = size.x / SideSubdivision;
-	float fStepZ = size.y / SideSubdivision;
-	glm::vec3& Start = glm::vec3(center.x - size.x * 0.5f, center.y, center.z - size.y * 0.5f) ;
-	for (unsigned int iVertexX = 0; iVertexX < NbVertexBySide; ++iVertexX) {
-		for (unsigned int iVertexZ = 0; iVertexZ < NbVertexBySide; ++iVertexZ) {
-			unsigned int Indice = iVertexX * NbVertexBySide + iVertexZ;
-			vertices[Indice] = { Start.x + iVertexX * fStepX, Start.y, Start.z + iVertexZ * fStepZ };
-			normals[Indice] = { 0.f, 1.f, 0.f };
-			colors[Indice] = color;
-		}
-	}
-
-	for (unsigned int iSquareX = 0; iSquareX < SideSubdivision; ++iSquareX) {
-		for (unsigned int iSquareY = 0; iSquareY < SideSubdivision; ++iSquareY) {
-			unsigned int iVertexStart = iSquareX * NbVertexBySide + iSquareY;
-			unsigned int iIndiceStart = (iSquareX * SideSubdivision + iSquareY) * 6;
-			indices[iIndiceStart + 0] = iVertexStart;
-			indices[iIndiceStart + 1] = iVertexStart + 1;
-			indices[iIndiceStart + 2] = iVertexStart + NbVertexBySide + 1;
-			indices[iIndiceStart + 3] = iVertexStart;
-			indices[iIndiceStart + 4] = iVertexStart + NbVertexBySide + 1;
-			indices[iIndiceStart + 5] = iVertexStart + NbVertexBySide;
-		}
-	}
-	
-
-	Buffer3D buffer3D;
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = normals;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.pIndices = indices;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createCubeBufferParams.indexCount = indiceCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
-	buffer(buffer3D, eDrawMode::Triangles, nullptr);
-
-	deleteBuffer3D(buffer3D);
-	Allocator.Free(indices);
-	Allocator.Free(colors);
-	Allocator.Free(normals);
-	Allocator.Free(vertices);
+void RenderApi3D::deleteMesh(MeshHandle mesh) const {
+	deletePoolMesh(pRenderEngine->meshPool, mesh);
+}
+
+void RenderApi3D::customShader(char const* szDefines) const {
+	RenderEngine& engine = *pRenderEngine;
+	assert(pShader3D == &engine.shader3D_custom); // only in render3D_custom
+	engine.pCustomShader3D = &getCustomShaderPermutation(engine, szDefines);
 }
 
 void RenderApi2D::buffer(const Buffer2D& buffer, eDrawMode drawMode) const {
-	assert(buffer.vao); // did you call createDrawBuffer2D ?
-	glBindVertexArray(buffer.vao);
-	glDrawArrays((GLenum)drawMode, 0, buffer.vertexCount);
-	glBindVertexArray(0);
+	// keep the submission order with the shapes before it
+	RenderEngine& engine = *pRenderEngine;
+	flushDrawList2D(engine.drawList2D, engine.glState, engine.streamBuffer, engine.shader2D.programId, engine.streamVao2D, engine.shader2D_sdf.programId, engine.streamShapeVao2D);
+	useProgram(engine.glState, engine.shader2D.programId);
+	drawBuffer2D(engine, buffer, drawMode);
 }
 
 void RenderApi2D::lines(glm::vec2 const* vertices, unsigned int vertexCount, const glm::vec4& color) const {
-	glm::vec4* colors = new glm::vec4[vertexCount];
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
-	}
-
-	Buffer2D buffer2D;
+	appendVertices2D(*pRenderEngine, vertices, vertexCount, eDrawMode::Lines, color);
+}
 
-	CreateBuffer2DParams createBufferParams;
-	createBufferParams.pColors = colors;
-	createBufferParams.pVertices = vertices;
-	createBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createBufferParams);
+void RenderApi2D::lineStrip(glm::vec2 const* vertices, unsigned int vertexCount, const glm::vec4& color, float width) const {
+	lineStrips(vertices, &vertexCount, 1, color, width);
+}
 
-	buffer(buffer2D, eDrawMode::Lines);
+void RenderApi2D::lineStrips(glm::vec2 const* vertices, unsigned int const* stripVertexCounts, unsigned int stripCount, const glm::vec4& color, float width) const {
+	DrawList2D& list = pRenderEngine->drawList2D;
+	const uint32_t packedColor = packVertexColor(color);
 
-	deleteBuffer2D(buffer2D);
+	glm::vec2 const* pSource = vertices;
+	for (unsigned int iStrip = 0; iStrip < stripCount; ++iStrip) {
+		const unsigned int vertexCount = stripVertexCounts[iStrip];
+		if (vertexCount < 2) {
+			pSource += vertexCount;
+			continue;
+		}
 
-	delete[] colors;
+		if (width <= 0.f) {
+			StreamVertex2D* pVertices = appendLineStrip2D(list, vertexCount);
+			for (unsigned int i = 0; i < vertexCount; ++i) {
+				pVertices[i] = { pSource[i], packedColor };
+			}
+		}
+		else {
+			// 2D vertices are already in pixels: segments are expanded here, extended by half the width to close the joints
+			StreamVertex2D* pVertices = appendTriangles2D(list, (vertexCount - 1) * 6);
+			for (unsigned int i = 0; i + 1 < vertexCount; ++i) {
+				const glm::vec2 segment = pSource[i + 1] - pSource[i];
+				const float length = glm::length(segment);
+				const glm::vec2 direction = length > 0.f ? segment / length * (0.5f * width) : glm::vec2(0.5f * width, 0.f);
+				const glm::vec2 normal = { -direction.y, direction.x };
+				const glm::vec2 start = pSource[i] - direction;
+				const glm::vec2 end = pSource[i + 1] + direction;
+				*pVertices++ = { start - normal, packedColor };
+				*pVertices++ = { end - normal, packedColor };
+				*pVertices++ = { end + normal, packedColor };
+				*pVertices++ = { start - normal, packedColor };
+				*pVertices++ = { end + normal, packedColor };
+				*pVertices++ = { start + normal, packedColor };
+			}
+		}
+		pSource += vertexCount;
+	}
 }
 
 void RenderApi2D::quadFill(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) const {
@@ -499,22 +692,7 @@ void RenderApi2D::quadFill(const glm::vec2& min, const glm::vec2& max, const glm
 	};
 	constexpr unsigned int vertexCount = COUNTOF(vertices);
 
-	glm::vec4 colors[vertexCount];
-	for (unsigned int iColor = 0; iColor < vertexCount; ++iColor) {
-		colors[iColor] = color;
-	}
-
-	Buffer2D buffer2D;
-
-	CreateBuffer2DParams createSquareBufferParams;
-	createSquareBufferParams.pColors = colors;
-	createSquareBufferParams.pVertices = vertices;
-	createSquareBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createSquareBufferParams);
-
-	buffer(buffer2D, eDrawMode::Triangles);
-
-	deleteBuffer2D(buffer2D);
+	appendVertices2D(*pRenderEngine, vertices, vertexCount, eDrawMode::Triangles, color);
 }
 
 void RenderApi2D::quadContour(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) const {
@@ -534,68 +712,81 @@ void RenderApi2D::quadContour(const glm::vec2& min, const glm::vec2& max, const
 }
 
 void RenderApi2D::circleFill(const glm::vec2& center, float radius, unsigned int subdivisions, const glm::vec4& color) const {
-	subdivisions = glm::max(subdivisions, 4u);
+	if (pRenderEngine->analyticShapes2D) {
+		appendShape2D(*pRenderEngine, center, glm::vec2(1.f, 0.f), glm::vec2(radius), radius, 0.f, color);
+		return;
+	}
 
-	const unsigned int vertexCount = subdivisions * 3;
+	glm::vec2 const* pCircle = nullptr;
+	if (subdivisions == AutoSubdivisions) {
+		const unsigned int level = getLodLevel(radius);
+		subdivisions = lodSubdivisions[level];
+		pCircle = getCircleTable(pRenderEngine->circleTables, level);
+	}
+	subdivisions = glm::max(subdivisions, 4u);
 
-	glm::vec2* vertices = new glm::vec2[vertexCount];
-	glm::vec4* colors = new glm::vec4[vertexCount];
+	const uint32_t packedColor = packVertexColor(color);
+	StreamVertex2D* pVertices = appendTriangles2D(pRenderEngine->drawList2D, subdivisions * 3);
 
-	int iVertex = 0;
 	glm::vec2 prev = { center.x + radius, center.y };
 	for (unsigned int i = 1; i <= subdivisions; ++i) {
-		const glm::vec2 current = {
+		const glm::vec2 current = pCircle ? center + radius * pCircle[i] : glm::vec2(
 			center.x + radius * glm::cos(glm::two_pi<float>() * i / float(subdivisions)),
-			center.y + radius * glm::sin(glm::two_pi<float>() * i / float(subdivisions)),
-		};
-		vertices[iVertex++] = center;
-		vertices[iVertex++] = prev;
-		vertices[iVertex++] = current;
+			center.y + radius * glm::sin(glm::two_pi<float>() * i / float(subdivisions))
+		);
+		*pVertices++ = { center, packedColor };
+		*pVertices++ = { prev, packedColor };
+		*pVertices++ = { current, packedColor };
 		prev = current;
 	}
-
-	for (unsigned int iColor = 0; iColor < vertexCount; ++iColor) {
-		colors[iColor] = color;
-	}
-
-	Buffer2D buffer2D;
-
-	CreateBuffer2DParams createSquareBufferParams;
-	createSquareBufferParams.pColors = colors;
-	createSquareBufferParams.pVertices = vertices;
-	createSquareBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createSquareBufferParams);
-
-	buffer(buffer2D, eDrawMode::Triangles);
-
-	deleteBuffer2D(buffer2D);
-
-	delete[] vertices;
-	delete[] colors;
 }
 
 void RenderApi2D::circleContour(const glm::vec2& center, float radius, unsigned int subdivisions, const glm::vec4& color) const {
+	if (pRenderEngine->analyticShapes2D) {
+		ring(center, radius, 1.f, color);
+		return;
+	}
+
+	glm::vec2 const* pCircle = nullptr;
+	if (subdivisions == AutoSubdivisions) {
+		const unsigned int level = getLodLevel(radius);
+		subdivisions = lodSubdivisions[level];
+		pCircle = getCircleTable(pRenderEngine->circleTables, level);
+	}
 	subdivisions = glm::max(subdivisions, 4u);
 
-	const unsigned int vertexCount = subdivisions * 2;
+	const uint32_t packedColor = packVertexColor(color);
+	StreamVertex2D* pVertices = appendLines2D(pRenderEngine->drawList2D, subdivisions * 2);
 
-	glm::vec2* vertices = new glm::vec2[vertexCount];
-	
-	int iVertex = 0;
 	glm::vec2 prev = { center.x + radius, center.y };
 	for (unsigned int i = 1; i <= subdivisions; ++i) {
-		const glm::vec2 current = {
+		const glm::vec2 current = pCircle ? center + radius * pCircle[i] : glm::vec2(
 			center.x + radius * glm::cos(glm::two_pi<float>() * i / float(subdivisions)),
-			center.y + radius * glm::sin(glm::two_pi<float>() * i / float(subdivisions)),
-		};
-		vertices[iVertex++] = prev;
-		vertices[iVertex++] = current;
+			center.y + radius * glm::sin(glm::two_pi<float>() * i / float(subdivisions))
+		);
+		*pVertices++ = { prev, packedColor };
+		*pVertices++ = { current, packedColor };
 		prev = current;
 	}
+}
 
-	lines(vertices, vertexCount, color);
+void RenderApi2D::ring(const glm::vec2& center, float radius, float thickness, const glm::vec4& color) const {
+	appendShape2D(*pRenderEngine, center, glm::vec2(1.f, 0.f), glm::vec2(radius), radius, thickness, color);
+}
+
+void RenderApi2D::capsule(const glm::vec2& from, const glm::vec2& to, float radius, const glm::vec4& color) const {
+	const glm::vec2 dir = to - from;
+	const float length = glm::length(dir);
+	const glm::vec2 axis = length > 0.f ? dir / length : glm::vec2(1.f, 0.f);
+	appendShape2D(*pRenderEngine, (from + to) * 0.5f, axis, glm::vec2(length * 0.5f + radius, radius), radius, 0.f, color);
+}
+
+void RenderApi2D::roundedQuadFill(const glm::vec2& min, const glm::vec2& max, float cornerRadius, const glm::vec4& color) const {
+	appendShape2D(*pRenderEngine, (min + max) * 0.5f, glm::vec2(1.f, 0.f), (max - min) * 0.5f, cornerRadius, 0.f, color);
+}
 
-	delete[] vertices;
+void RenderApi2D::roundedQuadContour(const glm::vec2& min, const glm::vec2& max, float cornerRadius, float thickness, const glm::vec4& color) const {
+	appendShape2D(*pRenderEngine, (min + max) * 0.5f, glm::vec2(1.f, 0.f), (max - min) * 0.5f, cornerRadius, thickness, color);
 }
 
 void RenderApi2D::arrow(const glm::vec2& from, const glm::vec2& to, float thickness, float hatRatio /*between 0 and 1*/, const glm::vec4& color) const {
@@ -622,20 +813,5 @@ void RenderApi2D::arrow(const glm::vec2& from, const glm::vec2& to, float thickn
 
 	constexpr unsigned int vertexCount = COUNTOF(vertices);
 
-	glm::vec4 colors[vertexCount];
-	for (unsigned int iColor = 0; iColor < vertexCount; ++iColor) {
-		colors[iColor] = color;
-	}
-
-	Buffer2D buffer2D;
-
-	CreateBuffer2DParams createSquareBufferParams;
-	createSquareBufferParams.pColors = colors;
-	createSquareBufferParams.pVertices = vertices;
-	createSquareBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createSquareBufferParams);
-
-	buffer(buffer2D, eDrawMode::Triangles);
-
-	deleteBuffer2D(buffer2D);
+	appendVertices2D(*pRenderEngine, vertices, vertexCount, eDrawMode::Triangles, color);
 }
\ No newline at end of file
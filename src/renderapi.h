@@ -1,55 +1,129 @@
 #pragma once
 
 #include <glad.h>
-#include <glm/fwd.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "meshpool.h"
 
 struct Buffer3D;
 struct Buffer2D;
 struct RenderEngine;
-struct ShaderProgram3D;
+struct ShaderProgram;
 
 enum class eDrawMode : GLenum {
 	Triangles = GL_TRIANGLES,
 	Lines = GL_LINES,
+	LineStrip = GL_LINE_STRIP,
 	Points = GL_POINTS,
 };
 
+// subdivision count of solidSphere, solidSpheres, circleFill and circleContour picked from their size on screen
+constexpr unsigned int AutoSubdivisions = 0;
+
+struct SphereInstance {
+	glm::vec3 center;
+	float radius;
+	glm::vec4 color;
+};
+
+struct CubeInstance {
+	glm::vec3 center;
+	float size;
+	glm::vec4 color;
+};
+
+struct BoneInstance {
+	glm::quat parentAbsoluteRotation;
+	glm::vec3 parentAbsolutePosition;
+	glm::vec3 childRelativePosition;
+	glm::vec4 color;
+};
+
+// draws and instances with a color alpha below 1 are drawn after the opaque ones, back to front and without depth writes
 struct RenderApi3D {
-	RenderEngine const* pRenderEngine;
-	ShaderProgram3D const* pShader3D;
+	RenderEngine* pRenderEngine;
+	ShaderProgram* pShader3D;
 
 
+	// draws are recorded and submitted at the end of the 3D pass: buffer must stay alive until then
 	void buffer(const Buffer3D& buffer, eDrawMode drawMode, glm::mat4 const* pModel) const;
 
-	// warning: if you want to draw A-B-C-D, then vertices should contain A-B-B-C-C-D 
+	// warning: if you want to draw A-B-C-D, then vertices should contain A-B-B-C-C-D (or use lineStrip)
 	void lines(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel) const;
 
+	// A-B-C-D draws A-B, B-C and C-D. width in pixels, 0 for one pixel lines
+	void lineStrip(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel, float width = 0.f) const;
+
+	// stripCount strips of stripVertexCounts[i] vertices, one after the other in vertices, in a single draw
+	void lineStrips(glm::vec3 const* vertices, unsigned int const* stripVertexCounts, unsigned int stripCount, const glm::vec4& color, glm::mat4 const* pModel, float width = 0.f) const;
+
 	void grid(float size, unsigned int subdivisions, const glm::vec4& color, glm::mat4 const* pModel) const;
 
 	void axisXYZ(glm::mat4 const* pModel) const;
 
 	void solidCube(float size, const glm::vec4& color, glm::mat4 const* pModel) const;
 
+	// AutoSubdivisions as horizontalSubdivisions picks both counts
 	void solidSphere(const glm::vec3& center, float radius, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions, const glm::vec4& color) const;
 
 	void bone(const glm::vec3& childRelativePosition, const glm::vec4& color, const glm::quat& parentAbsoluteRotation, const glm::vec3& parentAbsolutePosition) const;
 	
 	void horizontalPlane(const glm::vec3& center, const glm::vec2& size, unsigned int SideSubdivision, const glm::vec4& color) const;
+
+	// batch versions, one instanced draw for the whole array (one per LOD level with AutoSubdivisions)
+	void solidSpheres(SphereInstance const* spheres, unsigned int count, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions) const;
+
+	void solidCubes(CubeInstance const* cubes, unsigned int count) const;
+
+	void bones(BoneInstance const* bones, unsigned int count) const;
+
+	// retained meshes, owned by the render engine until deleteMesh
+	// they can be created and updated outside of the render callbacks (Viewer::api3D), params.defaultVertexBuffer is set by the engine
+	MeshHandle createMesh(const CreateBuffer3DParams& params) const;
+
+	// updates apply to every draw of the mesh in the current frame: update before drawing
+	void updateMeshRange(MeshHandle mesh, const UpdateBuffer3DParams& params) const;
+
+	void drawMesh(MeshHandle mesh, eDrawMode drawMode, const glm::vec4& color, glm::mat4 const* pModel) const;
+
+	// draws already recorded this frame stay valid, the mesh is released at the end of the frame
+	void deleteMesh(MeshHandle mesh) const;
+
+	// render3D_custom only: the next draws use shader_3d_custom.vert compiled with these "#define" lines,
+	// e.g. "#define ShaderType 2\n" for the wave. each set is compiled the first time it is used, nullptr is the default
+	void customShader(char const* szDefines) const;
 };
 
+// shapes are batched and drawn at the end of the 2D pass, lines over triangles and analytic shapes last
 struct RenderApi2D {
-	RenderEngine const* pRenderEngine;
+	RenderEngine* pRenderEngine;
 
+	// drawn right away, after the shapes already submitted
 	void buffer(const Buffer2D& buffer, eDrawMode drawMode) const;
 
-	// warning: if you want to draw A-B-C-D, then vertices should contain A-B-B-C-C-D 
+	// warning: if you want to draw A-B-C-D, then vertices should contain A-B-B-C-C-D (or use lineStrip)
 	void lines(glm::vec2 const* vertices, unsigned int vertexCount, const glm::vec4& color) const;
 
+	// same as the 3D versions, thick strips are triangles
+	void lineStrip(glm::vec2 const* vertices, unsigned int vertexCount, const glm::vec4& color, float width = 0.f) const;
+	void lineStrips(glm::vec2 const* vertices, unsigned int const* stripVertexCounts, unsigned int stripCount, const glm::vec4& color, float width = 0.f) const;
+
 	void quadFill(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) const;
 	void quadContour(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) const;
 
+	// radius in pixels, AutoSubdivisions picks the subdivisions from it
+	// with RenderParams::analyticShapes2D they are drawn as analytic shapes and the subdivisions are ignored
 	void circleFill(const glm::vec2& center, float radius, unsigned int subdivisions, const glm::vec4& color) const;
 	void circleContour(const glm::vec2& center, float radius, unsigned int subdivisions, const glm::vec4& color) const;
 
+	// analytic shapes: one quad each, antialiased from a signed distance in the fragment shader
+	// thickness is the width of the outline, inside the shape
+	void ring(const glm::vec2& center, float radius, float thickness, const glm::vec4& color) const;
+	void capsule(const glm::vec2& from, const glm::vec2& to, float radius, const glm::vec4& color) const;
+	void roundedQuadFill(const glm::vec2& min, const glm::vec2& max, float cornerRadius, const glm::vec4& color) const;
+	void roundedQuadContour(const glm::vec2& min, const glm::vec2& max, float cornerRadius, float thickness, const glm::vec4& color) const;
+
 	void arrow(const glm::vec2& from, const glm::vec2& to, float thickness, float hatRatio /*between 0 and 1*/, const glm::vec4& color) const;
 };
\ No newline at end of file
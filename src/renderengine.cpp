@@ -3,150 +3,431 @@
 #include "camera.h"
 #include "renderapi.h"
 
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#ifndef SHADER_CACHE_PATH
+#define SHADER_CACHE_PATH "shadercache/"
+#endif
+
+namespace {
+	// size of the stream buffer region written each frame
+	constexpr GLsizeiptr STREAM_BUFFER_REGION_SIZE = 16 * 1024 * 1024;
+
+	constexpr uint32_t ViewportSizeName = hashShaderName("ViewportSize");
+	constexpr uint32_t FrameDataName = hashShaderName("FrameData");
+	constexpr uint32_t DrawDataBufferName = hashShaderName("DrawDataBuffer");
+
+	bool createRenderEngineShaders(RenderEngine& engine) {
+		if (!createShaderProgram3D(engine.shader3D, &engine.shaderCache)) {
+			return false;
+		}
+		if (!createShaderProgram3D_custom(engine.shader3D_custom, &engine.shaderCache)) {
+			return false;
+		}
+		if (!createShaderProgram3D_thickLine(engine.shader3D_thickLine, &engine.shaderCache)) {
+			return false;
+		}
+		if (!createShaderProgram2D(engine.shader2D, &engine.shaderCache)) {
+			return false;
+		}
+		if (!createShaderProgram2D_sdf(engine.shader2D_sdf, &engine.shaderCache)) {
+			return false;
+		}
+		return true;
+	}
+
+	// the programs not created have no id
+	void deleteRenderEngineShaders(RenderEngine& engine) {
+		glDeleteProgram(engine.shader3D.programId);
+		glDeleteProgram(engine.shader3D_custom.programId);
+		glDeleteProgram(engine.shader3D_thickLine.programId);
+		glDeleteProgram(engine.shader2D.programId);
+		glDeleteProgram(engine.shader2D_sdf.programId);
+		engine.shader3D.programId = 0;
+		engine.shader3D_custom.programId = 0;
+		engine.shader3D_thickLine.programId = 0;
+		engine.shader2D.programId = 0;
+		engine.shader2D_sdf.programId = 0;
+	}
+
+	ShaderProgram& getEngineProgram(RenderEngine& engine, eEngineProgram program) {
+		switch (program) {
+		case eEngineProgram::Shader3D:
+			return engine.shader3D;
+		case eEngineProgram::Shader3D_custom:
+			return engine.shader3D_custom;
+		case eEngineProgram::Shader3D_thickLine:
+			return engine.shader3D_thickLine;
+		case eEngineProgram::Shader2D:
+			return engine.shader2D;
+		default:
+			assert(program == eEngineProgram::Shader2D_sdf);
+			return engine.shader2D_sdf;
+		}
+	}
+
+	// the C++ layouts match the blocks declared by the program, the blocks it does not use are not checked
+	bool checkBlockLayouts(const ShaderProgram& program) {
+		if (checkShaderBlock(program, FrameDataName, FrameData3D::Binding, sizeof(FrameData3D))
+			&& checkShaderBlock(program, DrawDataBufferName, DrawData3D::Binding, sizeof(DrawData3D))) {
+			return true;
+		}
+		fprintf(stderr, "The blocks of %s do not match FrameData3D and DrawData3D\n", program.szVertFilePath);
+		return false;
+	}
+
+	// a pending build of the program is abandoned, the files may have changed again
+	bool beginProgramRebuild(RenderEngine& engine, const ShaderProgram& current, ShaderProgramBuild& build) {
+		deleteShaderProgramBuild(build);
+
+		CreateShaderProgramParams params;
+		params.szVertFilePath = current.szVertFilePath;
+		params.szFragFilePath = current.szFragFilePath;
+		params.szDefines = current.szDefines;
+		params.pCache = &engine.shaderCache;
+		params.parallelCompile = engine.parallelShaderCompile;
+		return beginShaderProgramBuild(build, params);
+	}
+
+	// true when the finished build replaced the program
+	bool endProgramRebuild(ShaderProgramBuild& build, ShaderProgram& program) {
+		if (!build.program.programId || !isShaderProgramBuildDone(build)) {
+			return false;
+		}
+		bool linked = endShaderProgramBuild(build);
+		if (linked && !checkBlockLayouts(build.program)) {
+			glDeleteProgram(build.program.programId);
+			linked = false;
+		}
+		if (linked) {
+			glDeleteProgram(program.programId);
+			program = build.program;
+		}
+		else {
+			fprintf(stderr, "Failed to rebuild %s and %s, the previous program is kept\n", program.szVertFilePath, program.szFragFilePath);
+		}
+		build.program = ShaderProgram();
+		return linked;
+	}
+
+	// one of the files of the last pollShaderWatcher is a source of the program or is included by one
+	bool isProgramChanged(const RenderEngine& engine, const ShaderProgram& program) {
+		const ShaderSourceCache& sources = engine.shaderCache.sources;
+		for (const std::string& path : engine.shaderWatcher.changedPaths) {
+			if (dependsOnShaderFile(sources, program.szVertFilePath, path.c_str()) || dependsOnShaderFile(sources, program.szFragFilePath, path.c_str())) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// every file read by the programs, includes too
+	void watchShaderSources(RenderEngine& engine) {
+		for (const ShaderSourceCache::File& file : engine.shaderCache.sources.files) {
+			watchShaderFile(engine.shaderWatcher, file.path.c_str());
+		}
+	}
+
+	bool hasExtension(char const* szExtension) {
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint iExtension = 0; iExtension < extensionCount; ++iExtension) {
+			if (!strcmp((char const*)glGetStringi(GL_EXTENSIONS, iExtension), szExtension)) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
 bool createRenderEngine(RenderEngine& engine) {
-	if (!createShaderProgram3D(engine.shader3D)) {
+	// without a binary format the programs are compiled each time
+	createShaderCache(engine.shaderCache, SHADER_CACHE_PATH);
+	if (!createRenderEngineShaders(engine)) {
+		deleteRenderEngine(engine);
 		return false;
 	}
-	if (!createShaderProgram3D_custom(engine.shader3D_custom)) {
+	for (int iProgram = 0; iProgram < (int)eEngineProgram::Count; ++iProgram) {
+		if (!checkBlockLayouts(getEngineProgram(engine, (eEngineProgram)iProgram))) {
+			deleteRenderEngine(engine);
+			return false;
+		}
+	}
+	// the driver compiles on its own threads by default, completion is polled with GL_COMPLETION_STATUS_KHR
+	engine.parallelShaderCompile = hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile");
+	createShaderWatcher(engine.shaderWatcher);
+	watchShaderSources(engine);
+	if (!createStreamBuffer(engine.streamBuffer, STREAM_BUFFER_REGION_SIZE)) {
+		deleteRenderEngine(engine);
 		return false;
 	}
-	if (!createShaderProgram2D(engine.shader2D)) {
+	if (!createGpuTimers(engine.gpuTimers)) {
+		deleteRenderEngine(engine);
 		return false;
 	}
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &engine.uniformBufferAlignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &engine.drawList3D.storageBufferAlignment);
+	engine.drawList3D.drawIdSupported = hasExtension("GL_ARB_shader_draw_parameters");
+	createDefaultVertexBuffer3D(engine.defaultVertexBuffer3D);
+	engine.meshCache.defaultVertexBuffer = engine.defaultVertexBuffer3D;
+	for (int iLayout = 0; iLayout < (int)eStreamLayout3D::Count; ++iLayout) {
+		createStreamVertexArray3D(engine.streamVaos3D[iLayout], engine.streamBuffer, (eStreamLayout3D)iLayout, engine.defaultVertexBuffer3D);
+	}
+	createStreamVertexArray2D(engine.streamVao2D, engine.streamBuffer);
+	createStreamShapeVertexArray2D(engine.streamShapeVao2D, engine.streamBuffer);
 	return true;
 }
 
+void deleteRenderEngine(RenderEngine& engine) {
+	deleteMeshCache(engine.meshCache);
+	deleteMeshPool(engine.meshPool);
+	deleteShaderDataBuffer(engine.customShaderData);
+	glDeleteVertexArrays((int)eStreamLayout3D::Count, engine.streamVaos3D);
+	memset(engine.streamVaos3D, 0, sizeof(engine.streamVaos3D));
+	glDeleteVertexArrays(1, &engine.streamVao2D);
+	glDeleteVertexArrays(1, &engine.streamShapeVao2D);
+	engine.streamVao2D = 0;
+	engine.streamShapeVao2D = 0;
+	deleteStreamBuffer(engine.streamBuffer);
+	deleteDefaultVertexBuffer3D(engine.defaultVertexBuffer3D);
+	deleteGpuTimers(engine.gpuTimers);
+	deleteShaderWatcher(engine.shaderWatcher);
+	for (ShaderProgramBuild& build : engine.shaderBuilds) {
+		deleteShaderProgramBuild(build);
+	}
+	for (unsigned int iPermutation = 0; iPermutation < engine.customPermutationCount; ++iPermutation) {
+		ShaderPermutation3D& permutation = engine.customPermutations[iPermutation];
+		deleteShaderProgramBuild(permutation.build);
+		glDeleteProgram(permutation.program.programId);
+		permutation = ShaderPermutation3D();
+	}
+	engine.customPermutationCount = 0;
+	deleteRenderEngineShaders(engine);
+	engine.shaderCache = ShaderCache();
+}
+
 bool reloadRenderEngineShaders(RenderEngine& engine) {
-	glDeleteProgram(engine.shader3D.programId);
-	glDeleteProgram(engine.shader3D_custom.programId);
-	glDeleteProgram(engine.shader2D.programId);
-	return createRenderEngine(engine);
+	for (ShaderSourceCache::File& file : engine.shaderCache.sources.files) {
+		invalidateShaderSource(engine.shaderCache.sources, file.path.c_str());
+	}
+
+	bool started = true;
+	for (int iProgram = 0; iProgram < (int)eEngineProgram::Count; ++iProgram) {
+		started &= beginProgramRebuild(engine, getEngineProgram(engine, (eEngineProgram)iProgram), engine.shaderBuilds[iProgram]);
+	}
+	for (unsigned int iPermutation = 0; iPermutation < engine.customPermutationCount; ++iPermutation) {
+		ShaderPermutation3D& permutation = engine.customPermutations[iPermutation];
+		started &= beginProgramRebuild(engine, permutation.program, permutation.build);
+	}
+	watchShaderSources(engine);
+	return started;
+}
+
+void updateRenderEngineShaders(RenderEngine& engine) {
+	if (pollShaderWatcher(engine.shaderWatcher)) {
+		// only the changed files are read again, the programs that do not depend on them are not rebuilt
+		for (const std::string& path : engine.shaderWatcher.changedPaths) {
+			invalidateShaderSource(engine.shaderCache.sources, path.c_str());
+		}
+		for (int iProgram = 0; iProgram < (int)eEngineProgram::Count; ++iProgram) {
+			const ShaderProgram& program = getEngineProgram(engine, (eEngineProgram)iProgram);
+			if (isProgramChanged(engine, program)) {
+				beginProgramRebuild(engine, program, engine.shaderBuilds[iProgram]);
+			}
+		}
+		for (unsigned int iPermutation = 0; iPermutation < engine.customPermutationCount; ++iPermutation) {
+			ShaderPermutation3D& permutation = engine.customPermutations[iPermutation];
+			// the failed ones too, the edit may fix them
+			if (isProgramChanged(engine, permutation.program)) {
+				beginProgramRebuild(engine, permutation.program, permutation.build);
+			}
+		}
+		// the edits may include new files
+		watchShaderSources(engine);
+	}
+
+	bool swapped = false;
+	for (int iProgram = 0; iProgram < (int)eEngineProgram::Count; ++iProgram) {
+		swapped |= endProgramRebuild(engine.shaderBuilds[iProgram], getEngineProgram(engine, (eEngineProgram)iProgram));
+	}
+	for (unsigned int iPermutation = 0; iPermutation < engine.customPermutationCount; ++iPermutation) {
+		ShaderPermutation3D& permutation = engine.customPermutations[iPermutation];
+		if (endProgramRebuild(permutation.build, permutation.program)) {
+			permutation.failed = false;
+			swapped = true;
+		}
+	}
+
+	// a new program may reuse the name of the deleted one
+	if (swapped) {
+		invalidateGLStateCache(engine.glState);
+	}
+}
+
+ShaderProgram& getCustomShaderPermutation(RenderEngine& engine, char const* szDefines) {
+	if (!szDefines || !*szDefines) {
+		return engine.shader3D_custom;
+	}
+	for (unsigned int iPermutation = 0; iPermutation < engine.customPermutationCount; ++iPermutation) {
+		ShaderPermutation3D& permutation = engine.customPermutations[iPermutation];
+		if (permutation.defines == szDefines) {
+			return permutation.failed ? engine.shader3D_custom : permutation.program;
+		}
+	}
+	if (engine.customPermutationCount == RenderEngine::MaxCustomPermutations) {
+		fprintf(stderr, "Too many custom shader permutations, %s uses the default one\n", szDefines);
+		return engine.shader3D_custom;
+	}
+
+	// the defines are not compiled in the other permutations, each one only pays for its own branches
+	ShaderPermutation3D& permutation = engine.customPermutations[engine.customPermutationCount++];
+	permutation.defines = szDefines;
+	permutation.failed = !createShaderProgram3D_custom(permutation.program, &engine.shaderCache, permutation.defines.c_str());
+	if (!permutation.failed && !checkBlockLayouts(permutation.program)) {
+		glDeleteProgram(permutation.program.programId);
+		permutation.program.programId = 0;
+		permutation.failed = true;
+	}
+	return permutation.failed ? engine.shader3D_custom : permutation.program;
 }
 
-void renderEngineFrame(const RenderEngine& engine, const RenderParams& params) {
+void renderEngineFrame(RenderEngine& engine, const RenderParams& params) {
 	if(!params.viewportWidth || !params.viewportHeight) {
 		return;
 	}
+
+	beginStreamBufferFrame(engine.streamBuffer);
+	beginGpuTimersFrame(engine.gpuTimers);
+	beginGpuPass(engine.gpuTimers, eGpuPass::Opaque3D);
+	engine.drawList3D.deferred = params.deferred3D;
+	beginDrawList3D(engine.drawList3D);
+
 	glViewport(0, 0, params.viewportWidth, params.viewportHeight);
 
-	// Clear the front buffer
+	// Clear the front buffer, the depth mask applies to glClear
+	setDepthWriteEnabled(engine.glState, true);
 	glClearColor(params.backgroundColor.r, params.backgroundColor.g, params.backgroundColor.b, params.backgroundColor.a);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	glPointSize(params.pointSize);
 	glLineWidth(params.lineWidth);
 
-	// save previous gl state
-	GLboolean bEnableBlend;
-	glGetBooleanv(GL_BLEND, &bEnableBlend);
-	GLint SrcFactorRGB;
-	glGetIntegerv(GL_BLEND_SRC_RGB, &SrcFactorRGB);
-	GLint DstFactorRGB;
-	glGetIntegerv(GL_BLEND_DST_RGB, &DstFactorRGB);
-	GLint SrcFactorAlpha;
-	glGetIntegerv(GL_BLEND_SRC_ALPHA, &SrcFactorAlpha);
-	GLint DstFactorAlpha;
-	glGetIntegerv(GL_BLEND_DST_ALPHA, &DstFactorAlpha);
-
-	GLboolean bDepthTest;
-	glGetBooleanv(GL_DEPTH_TEST, &bDepthTest);
+	engine.glState.stateChanges = 0;
+	engine.glState.redundantChangesAvoided = 0;
+	engine.stats.visibleObjects3D = 0;
+	engine.stats.culledObjects3D = 0;
 
 	// set gl state
-	glEnable(GL_BLEND);
-
-	glBlendFuncSeparate(
+	setBlendEnabled(engine.glState, true);
+	setBlendFunc(engine.glState,
 		GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,   // src/dst rgb
 		GL_ONE, GL_ONE_MINUS_SRC_ALPHA    // src/dst alpha
 	);
 
 	// 3d
 	{
-		glEnable(GL_DEPTH_TEST);
+		setDepthTestEnabled(engine.glState, true);
 
 		const Camera& camera = *params.pCamera;
 		glm::mat4 projection = glm::perspective(camera.fov, params.viewportWidth / float(params.viewportHeight), 0.1f, 100.f);
 		glm::mat4 view = glm::lookAt(camera.eye, camera.o, camera.up);
 		glm::vec4 lightViewSpace = view * params.lightPosition;
 
-		const ShaderProgram3D& shader3D = engine.shader3D;
-
-		glUseProgram(shader3D.programId);
-
-		glProgramUniformMatrix4fv(shader3D.programId, shader3D.viewLocation, 1, 0, glm::value_ptr(view));
-		glProgramUniformMatrix4fv(shader3D.programId, shader3D.projectionLocation, 1, 0, glm::value_ptr(projection));
+		// shared by every 3D program through the FrameData uniform block
+		GLintptr frameDataOffset;
+		FrameData3D* pFrameData = (FrameData3D*)allocateStreamBuffer(engine.streamBuffer, sizeof(FrameData3D), engine.uniformBufferAlignment, frameDataOffset);
+		if (pFrameData) {
+			pFrameData->view = view;
+			pFrameData->projection = projection;
+			pFrameData->light = glm::vec3(lightViewSpace) / lightViewSpace.w;
+			pFrameData->ambient = params.lightAmbient;
+			pFrameData->specular = params.lightSpecular;
+			pFrameData->specularPow = params.lightSpecularPow;
+			pFrameData->time = params.time;
+			pFrameData->viewportSize = glm::vec2(float(params.viewportWidth), float(params.viewportHeight));
+			glBindBufferRange(GL_UNIFORM_BUFFER, FrameData3D::Binding, engine.streamBuffer.bufferId, frameDataOffset, sizeof(FrameData3D));
+		}
+		else {
+			fprintf(stderr, "Stream buffer is full, frame data skipped\n");
+		}
 
-		glm::vec3 lightViewSpaceVec3 = glm::vec3(lightViewSpace) / lightViewSpace.w;
-		glProgramUniform3fv(shader3D.programId, shader3D.lightLocation, 1, glm::value_ptr(lightViewSpaceVec3));
-		glProgramUniform1f(shader3D.programId, shader3D.ambientLocation, params.lightAmbient);
-		glProgramUniform1f(shader3D.programId, shader3D.specularLocation, params.lightSpecular);
-		glProgramUniform1f(shader3D.programId, shader3D.specularPowLocation, params.lightSpecularPow);
+		extractFrustumPlanes(engine.frustum3D, projection * view);
+		engine.frustumCulling3D = params.frustumCulling3D;
+		engine.cameraPosition = camera.eye;
+		engine.cameraDirection = glm::normalize(camera.o - camera.eye);
+		engine.lodPixelScale = params.viewportHeight / (2.f * glm::tan(camera.fov * 0.5f));
 
+		ShaderProgram& shader3D = engine.shader3D;
 		RenderApi3D api3D;
 		api3D.pShader3D = &shader3D;
 		api3D.pRenderEngine = &engine;
 		params.render3DCallback(api3D, params.pRender3DCallbackUserData);
 
+		// each pass draws its opaque commands, the transparent ones of both passes are drawn last
+		flushDrawList3D(engine.drawList3D, engine.glState, engine.streamBuffer, true);
+		endGpuPass(engine.gpuTimers, eGpuPass::Opaque3D);
+
 		// 3D Custom vertex shader
-		const ShaderProgram3D_custom& shader3D_custom = engine.shader3D_custom;
-		glUseProgram(shader3D_custom.programId);
-		glProgramUniformMatrix4fv(shader3D_custom.programId, shader3D_custom.viewLocation, 1, 0, glm::value_ptr(view));
-		glProgramUniformMatrix4fv(shader3D_custom.programId, shader3D_custom.projectionLocation, 1, 0, glm::value_ptr(projection));
-	
-		glProgramUniform3fv(shader3D_custom.programId, shader3D_custom.lightLocation, 1, glm::value_ptr(lightViewSpaceVec3));
-		glProgramUniform1f(shader3D_custom.programId, shader3D_custom.ambientLocation, params.lightAmbient);
-		glProgramUniform1f(shader3D_custom.programId, shader3D_custom.specularLocation, params.lightSpecular);
-		glProgramUniform1f(shader3D_custom.programId, shader3D_custom.specularPowLocation, params.lightSpecular);
-		glProgramUniform1f(shader3D_custom.programId, shader3D_custom.timeLocation, params.time);
-		
-		GLuint ssbo = 0;
-		glGenBuffers(1, &ssbo);
-		if (params.pCustomVertShaderData != nullptr) {
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ssbo);
-			glBufferData(GL_SHADER_STORAGE_BUFFER, params.CustomVertShaderDataSize, params.pCustomVertShaderData, GL_DYNAMIC_COPY);
-		}
+		ShaderProgram& shader3D_custom = engine.shader3D_custom;
+		beginShaderDataFrame(engine.customShaderData, 3, params.pCustomVertShaderData, params.CustomVertShaderDataSize,
+			params.customVertShaderDataVersion, params.customVertShaderDataDirtyOffset, params.customVertShaderDataDirtySize);
+
+		beginGpuPass(engine.gpuTimers, eGpuPass::Custom3D);
 		api3D.pShader3D = &shader3D_custom;
+		engine.frustumCulling3D = false;
 		params.render3DCustomCallback(api3D, params.pRender3DCustomCallbackUserData);
-		glDeleteBuffers(1, &ssbo);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		engine.pCustomShader3D = nullptr;
+		flushDrawList3D(engine.drawList3D, engine.glState, engine.streamBuffer, true);
+		endGpuPass(engine.gpuTimers, eGpuPass::Custom3D);
 
+		beginGpuPass(engine.gpuTimers, eGpuPass::Transparent3D);
+		flushDrawList3D(engine.drawList3D, engine.glState, engine.streamBuffer);
+		endGpuPass(engine.gpuTimers, eGpuPass::Transparent3D);
 	}
 
 	// 2d
 	{
-		glDisable(GL_DEPTH_TEST);
-
-		const ShaderProgram2D& shader2D = engine.shader2D;
+		beginGpuPass(engine.gpuTimers, eGpuPass::Overlay2D);
+		setDepthTestEnabled(engine.glState, false);
 
+		ShaderProgram& shader2D = engine.shader2D;
 
-		glUseProgram(shader2D.programId);
+		useProgram(engine.glState, shader2D.programId);
 
 		glm::vec2 viewportSize = {
 			float(params.viewportWidth),
 			float(params.viewportHeight),
 		};
-		glProgramUniform2fv(shader2D.programId, shader2D.viewportSizeLocation, 1, glm::value_ptr(viewportSize));
+		setShaderParameter(shader2D, ViewportSizeName, viewportSize);
+		setShaderParameter(engine.shader2D_sdf, ViewportSizeName, viewportSize);
 
+		engine.analyticShapes2D = params.analyticShapes2D;
+		beginDrawList2D(engine.drawList2D);
 		RenderApi2D api2D;
 		api2D.pRenderEngine = &engine;
 		params.render2DCallback(api2D, params.pRender3DCallbackUserData);
+		flushDrawList2D(engine.drawList2D, engine.glState, engine.streamBuffer, shader2D.programId, engine.streamVao2D, engine.shader2D_sdf.programId, engine.streamShapeVao2D);
+		endGpuPass(engine.gpuTimers, eGpuPass::Overlay2D);
 	}
 
-	// restore gl state
-	if (bEnableBlend) {
-		glEnable(GL_BLEND);
-	}
-	else {
-		glDisable(GL_BLEND);
-	}
+	endStreamBufferFrame(engine.streamBuffer);
+	endShaderDataFrame(engine.customShaderData);
 
-	if (bDepthTest) {
-		glEnable(GL_DEPTH_TEST);
-	}
-	else {
-		glDisable(GL_DEPTH_TEST);
-	}
-}
\ No newline at end of file
+	// nothing stays bound between frames, buffers can be deleted safely
+	bindVertexArray(engine.glState, 0);
+	collectMeshPool(engine.meshPool);
+
+	engine.stats.drawCommands3D = engine.drawList3D.commandCount;
+	engine.stats.drawCalls3D = engine.drawList3D.drawCount;
+	engine.stats.drawCalls2D = engine.drawList2D.drawCount;
+	engine.stats.transparentCommands3D = engine.drawList3D.transparentCommandCount;
+	engine.stats.stateChanges = engine.glState.stateChanges;
+	engine.stats.redundantStateChangesAvoided = engine.glState.redundantChangesAvoided;
+	engine.stats.customShaderDataUploadedBytes = (unsigned int)engine.customShaderData.uploadedSize;
+	memcpy(engine.stats.gpuPassTimes, engine.gpuTimers.passTimes, sizeof(engine.stats.gpuPassTimes));
+}
@@ -3,11 +3,26 @@
 #include <glad.h>
 
 #include "shader.h"
+#include "shadercache.h"
+#include "shaderwatcher.h"
+#include "streambuffer.h"
+#include "drawlist.h"
+#include "meshcache.h"
+#include "meshpool.h"
+#include "glstate.h"
+#include "shaderdatabuffer.h"
+#include "frustum.h"
+#include "lod.h"
+#include "gputimer.h"
 
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 struct RenderApi3D;
 struct RenderApi2D;
 struct Camera;
@@ -15,14 +30,118 @@ struct RenderParams;
 struct Buffer3D;
 struct Buffer2D;
 
+// counters of the last frame
+struct RenderStats {
+	unsigned int drawCommands3D = 0;
+	unsigned int drawCalls3D = 0;
+	unsigned int drawCalls2D = 0;
+	unsigned int transparentCommands3D = 0;		// drawn back to front after the opaque ones
+	unsigned int stateChanges = 0;
+	unsigned int redundantStateChangesAvoided = 0;
+	unsigned int customShaderDataUploadedBytes = 0;
+	// 3D primitives and instances tested against the frustum
+	unsigned int visibleObjects3D = 0;
+	unsigned int culledObjects3D = 0;
+	// milliseconds per pass, measured a few frames ago (GpuTimers)
+	float gpuPassTimes[(int)eGpuPass::Count] = {};
+};
+
+// programs of the engine, indices of RenderEngine::shaderBuilds
+enum class eEngineProgram : int {
+	Shader3D = 0,
+	Shader3D_custom,
+	Shader3D_thickLine,
+	Shader2D,
+	Shader2D_sdf,
+	Count
+};
+
+// a variant of shader3D_custom compiled with its own defines, see RenderApi3D::customShader
+struct ShaderPermutation3D {
+	std::string defines;
+	ShaderProgram program = {};
+	ShaderProgramBuild build;		// hot reload
+	bool failed = false;			// its draws use shader3D_custom until a rebuild links
+};
+
 struct RenderEngine {
-	ShaderProgram3D shader3D;
-	ShaderProgram3D_custom shader3D_custom;
-	ShaderProgram2D shader2D;
+	enum {
+		MaxCustomPermutations = 16
+	};
+
+	ShaderProgram shader3D;
+	ShaderProgram shader3D_custom;
+	ShaderProgram shader3D_thickLine;
+	ShaderProgram shader2D;
+	ShaderProgram shader2D_sdf;
+	// compiled the first time a draw uses them. the draw list points to them: the array never moves
+	ShaderPermutation3D customPermutations[MaxCustomPermutations];
+	unsigned int customPermutationCount = 0;
+	ShaderProgram* pCustomShader3D = nullptr;	// picked by RenderApi3D::customShader, custom pass only
+	// linked programs of the previous runs
+	ShaderCache shaderCache;
+	// hot reload: the programs whose files change are rebuilt without waiting, a build replaces its program once linked
+	ShaderWatcher shaderWatcher;
+	ShaderProgramBuild shaderBuilds[(int)eEngineProgram::Count];
+	bool parallelShaderCompile = false;		// KHR_parallel_shader_compile, the builds do not block the frames
+
+	// immediate-mode geometry is written in the stream buffer and drawn with one of these vaos
+	StreamBuffer streamBuffer;
+	GLuint streamVaos3D[(int)eStreamLayout3D::Count] = {};
+	GLuint streamVao2D = 0;
+	GLuint streamShapeVao2D = 0;
+	// values of the attributes the vertex arrays do not source, see setDefaultVertexAttribs3D
+	GLuint defaultVertexBuffer3D = 0;
+	GLint uniformBufferAlignment = 256;
+
+	DrawList3D drawList3D;
+	DrawList2D drawList2D;
+	bool analyticShapes2D = false;		// RenderParams::analyticShapes2D of the frame
+
+	MeshCache meshCache;
+
+	// RenderParams::pCustomVertShaderData, read by shader3D_custom
+	ShaderDataBuffer customShaderData;
+
+	// meshes retained by the user code (RenderApi3D::createMesh)
+	MeshPool meshPool;
+
+	// every blend, depth, program and vertex array change of the engine goes through it
+	GLStateCache glState;
+
+	// world space frustum of the frame, RenderApi3D drops the primitives outside of it before any geometry work
+	Frustum frustum3D;
+	bool frustumCulling3D = false;		// off for the custom program, its vertex shader moves the vertices
+	// scratch memory of the batch tests
+	std::vector<glm::vec4> cullSpheres;
+	std::vector<uint8_t> cullVisibility;
+
+	// automatic LOD of the round primitives (AutoSubdivisions)
+	glm::vec3 cameraPosition = glm::vec3(0.f);
+	glm::vec3 cameraDirection = glm::vec3(0.f, 0.f, -1.f);		// view space depth of the transparent draws
+	float lodPixelScale = 1.f;		// pixels covered by a length of 1 at a distance of 1
+	CircleTables circleTables;
+	std::vector<uint8_t> lodLevels;		// scratch memory of the batches
+	RadixSortBuffer instanceSort;		// transparent instances of a batch, back to front
+
+	// timestamps of the passes, the viewer times the ImGui pass with it
+	GpuTimers gpuTimers;
+
+	RenderStats stats;
 };
 
+// on failure the members already created are deleted
 bool createRenderEngine(RenderEngine& engine);
+// also deletes a partially created engine
+void deleteRenderEngine(RenderEngine& engine);
+// rebuilds every program, the programs are replaced by updateRenderEngineShaders
 bool reloadRenderEngineShaders(RenderEngine& engine);
+// rebuilds the programs whose files changed and swaps in the finished builds, a failed build keeps the old program
+void updateRenderEngineShaders(RenderEngine& engine);
+
+// the permutation of shader3D_custom compiled with szDefines, compiled on the first call
+// shader3D_custom itself when szDefines is empty or when the permutation does not compile
+ShaderProgram& getCustomShaderPermutation(RenderEngine& engine, char const* szDefines);
 
 
 using Render3DCallback = void (const RenderApi3D& api, void* pUserData);
@@ -46,6 +165,13 @@ struct RenderParams {
 	float pointSize;
 	float lineWidth;
 
+	// record 3D draws and submit them sorted by state at the end of the 3D pass
+	bool deferred3D;
+	// drop the 3D primitives outside of the camera frustum, except for the custom vertex shader
+	bool frustumCulling3D;
+	// draw 2D circles as antialiased analytic shapes instead of polygons
+	bool analyticShapes2D;
+
 	glm::vec4 backgroundColor;
 
 	glm::vec4 lightPosition;
@@ -56,6 +182,10 @@ struct RenderParams {
 	float time;
 	void* pCustomVertShaderData;
 	unsigned int CustomVertShaderDataSize;
+	// the data is only uploaded when the version changes, then only the dirty range (all of it when the size is 0)
+	unsigned int customVertShaderDataVersion;
+	unsigned int customVertShaderDataDirtyOffset;
+	unsigned int customVertShaderDataDirtySize;
 };
 
-void renderEngineFrame(const RenderEngine& engine, const RenderParams& params);
\ No newline at end of file
+void renderEngineFrame(RenderEngine& engine, const RenderParams& params);
\ No newline at end of file
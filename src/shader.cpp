@@ -1,13 +1,27 @@
 #include "shader.h"
+#include "shadercache.h"
 #include "glad.h"
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
 
 #ifndef SHADER_PATH
 #define SHADER_PATH
 #endif
 
+#ifndef _WIN32
+#define _strdup strdup
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace {
 	// No windows implementation of strsep
 	char* strsep_custom(char** stringp, const char* delim) {
@@ -34,7 +48,31 @@ namespace {
 		return nullptr;
 	}
 
-	int checkCompileError(GLuint shader, const char** sourceBuffer) {
+	// the source string number starting a line of the log ("0:12(3): error" or "ERROR: 0:12: ...") is replaced by its file
+	void printCompileLog(char const* log, const std::vector<std::string>& filePaths) {
+		fprintf(stderr, "Compile : ");
+		for (char const* line = log; *line; ) {
+			char const* lineEnd = strchr(line, '\n');
+			const size_t lineLength = lineEnd ? lineEnd - line : strlen(line);
+			char const* number = line;
+			char const* colon = (char const*)memchr(line, ':', lineLength);
+			if (colon && colon[1] == ' ' && !isdigit((unsigned char)*line)) {
+				number = colon + 2;
+			}
+			char* numberEnd = nullptr;
+			const unsigned long sourceNumber = isdigit((unsigned char)*number) ? strtoul(number, &numberEnd, 10) : 0;
+			if (numberEnd && (*numberEnd == ':' || *numberEnd == '(') && sourceNumber < filePaths.size()) {
+				fprintf(stderr, "%.*s%s%.*s\n", (int)(number - line), line, filePaths[sourceNumber].c_str(),
+					(int)(line + lineLength - numberEnd), numberEnd);
+			}
+			else {
+				fprintf(stderr, "%.*s\n", (int)lineLength, line);
+			}
+			line += lineEnd ? lineLength + 1 : lineLength;
+		}
+	}
+
+	int checkCompileError(GLuint shader, const char** sourceBuffer, const std::vector<std::string>& filePaths) {
 		// Get error log size and print it eventually
 		int logLength;
 		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
@@ -49,7 +87,7 @@ namespace {
 				printf("%3d : %s\n", lc, token);
 				++lc;
 			}
-			fprintf(stderr, "Compile : %s", log);
+			printCompileLog(log, filePaths);
 			delete[] log;
 		}
 		// If an error happend quit
@@ -65,27 +103,20 @@ namespace {
 		const char* sc[1] = { sourceBuffer };
 		glShaderSource(shaderObject, 1, sc, NULL);
 		glCompileShader(shaderObject);
-		checkCompileError(shaderObject, sc);
 		return shaderObject;
 	}
 
-	GLuint compileShaderFromFile(GLenum shaderType, const char* path) {
-		FILE* shaderFileDesc = fopen(path, "rb");
-		if (!shaderFileDesc) {
-			fprintf(stderr, "Failed to open file %s \n", path);
-			return 0;
+	// the includes are pasted in the source, szDefines is inserted after the #version line when set
+	bool readShaderSource(ShaderSourceCache& sources, const char* path, const char* szDefines, std::string& source, std::vector<std::string>& filePaths) {
+		if (!preprocessShaderSource(sources, path, source, filePaths)) {
+			return false;
 		}
-
-		fseek(shaderFileDesc, 0, SEEK_END);
-		long fileSize = ftell(shaderFileDesc);
-		rewind(shaderFileDesc);
-		char* buffer = new char[fileSize + 1];
-		fread(buffer, 1, fileSize, shaderFileDesc);
-		buffer[fileSize] = '\0';
-		GLuint shaderObject = compileShader(shaderType, buffer, fileSize);
-		delete[] buffer;
-		fclose(shaderFileDesc);
-		return shaderObject;
+		if (szDefines && *szDefines) {
+			// the lines of the file continue after the defines
+			const size_t versionEnd = source.find('\n');
+			source.insert(versionEnd == std::string::npos ? source.size() : versionEnd + 1, std::string(szDefines) + "#line 2 0\n");
+		}
+		return true;
 	}
 
 	bool checkLinkError(GLuint program) {
@@ -104,76 +135,306 @@ namespace {
 			return false;
 		return true;
 	}
+
+	void reflectInterface(ShaderProgram& program, GLenum interface) {
+		GLint resourceCount = 0;
+		GLint maxNameLength = 0;
+		glGetProgramInterfaceiv(program.programId, interface, GL_ACTIVE_RESOURCES, &resourceCount);
+		glGetProgramInterfaceiv(program.programId, interface, GL_MAX_NAME_LENGTH, &maxNameLength);
+		std::vector<char> name(maxNameLength + 1);
+		for (GLint iResource = 0; iResource < resourceCount; ++iResource) {
+			ShaderParameter parameter;
+			parameter.interface = interface;
+			if (interface == GL_UNIFORM) {
+				const GLenum properties[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+				GLint values[4] = {};
+				glGetProgramResourceiv(program.programId, interface, iResource, 4, properties, 4, nullptr, values);
+				// the members of the blocks are written in their buffers, the built-in uniforms have no location
+				if (values[3] != -1 || values[1] < 0) {
+					continue;
+				}
+				parameter.type = (GLenum)values[0];
+				parameter.location = values[1];
+				parameter.size = values[2];
+			}
+			else {
+				const GLenum properties[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+				GLint values[2] = {};
+				glGetProgramResourceiv(program.programId, interface, iResource, 2, properties, 2, nullptr, values);
+				parameter.location = values[0];
+				parameter.size = values[1];
+			}
+			glGetProgramResourceName(program.programId, interface, iResource, (GLsizei)name.size(), nullptr, name.data());
+			parameter.nameHash = hashShaderName(name.data());
+
+			if (program.parameterCount == ShaderProgram::MaxParameters) {
+				fprintf(stderr, "Too many parameters in %s, %s is ignored\n", program.szVertFilePath, name.data());
+				continue;
+			}
+			program.parameters[program.parameterCount++] = parameter;
+		}
+	}
+
+	// false when the value is the last one uploaded
+	bool updateParameterValue(ShaderParameter& parameter, void const* pValue, size_t size) {
+		if (parameter.uploaded && !memcmp(parameter.value, pValue, size)) {
+			return false;
+		}
+		memcpy(parameter.value, pValue, size);
+		parameter.uploaded = true;
+		return true;
+	}
+
+	// null when the program does not use the uniform
+	ShaderParameter* findUniform(ShaderProgram& program, uint32_t nameHash) {
+		ShaderParameter const* pParameter = findShaderParameter(program, nameHash);
+		return pParameter && pParameter->interface == GL_UNIFORM ? &program.parameters[pParameter - program.parameters] : nullptr;
+	}
 }
 
 bool createShaderProgram(ShaderProgram& program, const CreateShaderProgramParams& params) {
-	// try to load and compile shaders
-	program.vertShaderId = compileShaderFromFile(GL_VERTEX_SHADER, params.szVertFilePath);
-	program.fragShaderId = compileShaderFromFile(GL_FRAGMENT_SHADER, params.szFragFilePath);
-	program.programId = glCreateProgram();
-	glAttachShader(program.programId, program.vertShaderId);
-	glAttachShader(program.programId, program.fragShaderId);
-	glLinkProgram(program.programId);
-	if (!checkLinkError(program.programId)) {
+	ShaderProgramBuild build;
+	if (!beginShaderProgramBuild(build, params) || !endShaderProgramBuild(build)) {
+		program = ShaderProgram();
+		program.programId = 0;
+		program.szVertFilePath = params.szVertFilePath;
+		program.szFragFilePath = params.szFragFilePath;
+		program.szDefines = params.szDefines;
+		return false;
+	}
+	program = build.program;
+	return true;
+}
+
+bool beginShaderProgramBuild(ShaderProgramBuild& build, const CreateShaderProgramParams& params) {
+	assert(!build.program.programId); // did you call endShaderProgramBuild ?
+	// without a cache the files are read for this build only
+	ShaderSourceCache localSources;
+	ShaderSourceCache& sources = params.pCache ? params.pCache->sources : localSources;
+	if (!readShaderSource(sources, params.szVertFilePath, params.szDefines, build.vertSource, build.vertFilePaths)
+		|| !readShaderSource(sources, params.szFragFilePath, params.szDefines, build.fragSource, build.fragFilePaths)) {
+		return false;
+	}
+
+	build.program.szVertFilePath = params.szVertFilePath;
+	build.program.szFragFilePath = params.szFragFilePath;
+	build.program.szDefines = params.szDefines;
+	build.pCache = params.pCache;
+	build.parallelCompile = params.parallelCompile;
+	build.fromCache = false;
+
+	// a cached binary skips the compilation and the link
+	if (params.pCache) {
+		char const* sources[] = { build.vertSource.c_str(), build.fragSource.c_str() };
+		build.cacheKey = getShaderCacheKey(*params.pCache, sources, 2);
+		build.program.programId = loadCachedProgram(*params.pCache, build.cacheKey);
+		if (build.program.programId) {
+			build.fromCache = true;
+			build.vertSource.clear();
+			build.fragSource.clear();
+			return true;
+		}
+	}
+
+	// try to load and compile shaders, the errors are read by endShaderProgramBuild
+	build.vertShaderId = compileShader(GL_VERTEX_SHADER, build.vertSource.c_str(), (int)build.vertSource.size());
+	build.fragShaderId = compileShader(GL_FRAGMENT_SHADER, build.fragSource.c_str(), (int)build.fragSource.size());
+	build.program.programId = glCreateProgram();
+	glAttachShader(build.program.programId, build.vertShaderId);
+	glAttachShader(build.program.programId, build.fragShaderId);
+	if (params.pCache) {
+		glProgramParameteri(build.program.programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(build.program.programId);
+	return true;
+}
+
+bool isShaderProgramBuildDone(const ShaderProgramBuild& build) {
+	if (build.fromCache || !build.parallelCompile) {
+		return true;
+	}
+	GLint done = GL_TRUE;
+	glGetProgramiv(build.program.programId, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool endShaderProgramBuild(ShaderProgramBuild& build) {
+	assert(build.program.programId); // did you call beginShaderProgramBuild ?
+	if (build.fromCache) {
+		reflectShaderProgram(build.program);
+		return true;
+	}
+
+	char const* vertSource = build.vertSource.c_str();
+	char const* fragSource = build.fragSource.c_str();
+	const bool vertCompiled = checkCompileError(build.vertShaderId, &vertSource, build.vertFilePaths) == 0;
+	const bool fragCompiled = checkCompileError(build.fragShaderId, &fragSource, build.fragFilePaths) == 0;
+	const bool linked = vertCompiled && fragCompiled && checkLinkError(build.program.programId);
+
+	// the linked program does not need the shader objects anymore
+	glDetachShader(build.program.programId, build.vertShaderId);
+	glDetachShader(build.program.programId, build.fragShaderId);
+	glDeleteShader(build.vertShaderId);
+	glDeleteShader(build.fragShaderId);
+	build.vertShaderId = 0;
+	build.fragShaderId = 0;
+	build.vertSource.clear();
+	build.fragSource.clear();
+	if (!linked) {
+		glDeleteProgram(build.program.programId);
+		build.program.programId = 0;
 		return false;
 	}
 
+	if (build.pCache) {
+		storeCachedProgram(*build.pCache, build.cacheKey, build.program.programId);
+	}
+	reflectShaderProgram(build.program);
 	return true;
 }
 
-void	 ShaderProgram3D::LoadLocation() {
-	modelLocation = glGetUniformLocation(programId, "Model");
-	viewLocation = glGetUniformLocation(programId, "View");
-	projectionLocation = glGetUniformLocation(programId, "Projection");
-	lightLocation = glGetUniformLocation(programId, "Light");
-	ambientLocation = glGetUniformLocation(programId, "Ambient");
-	specularLocation = glGetUniformLocation(programId, "Specular");
-	specularPowLocation = glGetUniformLocation(programId, "SpecularPow");
-	lightingEnabledLocation = glGetUniformLocation(programId, "LightingEnabled");
+void deleteShaderProgramBuild(ShaderProgramBuild& build) {
+	if (build.vertShaderId) {
+		glDeleteShader(build.vertShaderId);
+		glDeleteShader(build.fragShaderId);
+	}
+	if (build.program.programId) {
+		glDeleteProgram(build.program.programId);
+	}
+	build = ShaderProgramBuild();
+}
+
+void reflectShaderProgram(ShaderProgram& program) {
+	program.parameterCount = 0;
+	reflectInterface(program, GL_UNIFORM);
+	reflectInterface(program, GL_UNIFORM_BLOCK);
+	reflectInterface(program, GL_SHADER_STORAGE_BLOCK);
+	std::sort(program.parameters, program.parameters + program.parameterCount, [](const ShaderParameter& a, const ShaderParameter& b) {
+		return a.nameHash < b.nameHash;
+	});
+	for (unsigned int iParameter = 1; iParameter < program.parameterCount; ++iParameter) {
+		assert(program.parameters[iParameter - 1].nameHash != program.parameters[iParameter].nameHash); // two names with the same hash, rename one
+	}
+}
+
+ShaderParameter const* findShaderParameter(const ShaderProgram& program, uint32_t nameHash) {
+	ShaderParameter const* pEnd = program.parameters + program.parameterCount;
+	ShaderParameter const* pParameter = std::lower_bound(program.parameters, pEnd, nameHash, [](const ShaderParameter& parameter, uint32_t hash) {
+		return parameter.nameHash < hash;
+	});
+	return pParameter != pEnd && pParameter->nameHash == nameHash ? pParameter : nullptr;
+}
+
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, int value) {
+	ShaderParameter* pParameter = findUniform(program, nameHash);
+	if (!pParameter) {
+		return;
+	}
+	assert(pParameter->type == GL_INT || pParameter->type == GL_BOOL); // declared with another type
+	if (updateParameterValue(*pParameter, &value, sizeof(value))) {
+		glProgramUniform1i(program.programId, pParameter->location, value);
+	}
+}
+
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, float value) {
+	ShaderParameter* pParameter = findUniform(program, nameHash);
+	if (!pParameter) {
+		return;
+	}
+	assert(pParameter->type == GL_FLOAT); // declared with another type
+	if (updateParameterValue(*pParameter, &value, sizeof(value))) {
+		glProgramUniform1f(program.programId, pParameter->location, value);
+	}
+}
+
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, const glm::vec2& value) {
+	ShaderParameter* pParameter = findUniform(program, nameHash);
+	if (!pParameter) {
+		return;
+	}
+	assert(pParameter->type == GL_FLOAT_VEC2); // declared with another type
+	if (updateParameterValue(*pParameter, &value, sizeof(value))) {
+		glProgramUniform2fv(program.programId, pParameter->location, 1, &value.x);
+	}
+}
+
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, const glm::vec4& value) {
+	ShaderParameter* pParameter = findUniform(program, nameHash);
+	if (!pParameter) {
+		return;
+	}
+	assert(pParameter->type == GL_FLOAT_VEC4); // declared with another type
+	if (updateParameterValue(*pParameter, &value, sizeof(value))) {
+		glProgramUniform4fv(program.programId, pParameter->location, 1, &value.x);
+	}
 }
 
-bool createShaderProgram3D(ShaderProgram3D& program) {
+bool checkShaderBlock(const ShaderProgram& program, uint32_t nameHash, GLint binding, GLint dataSize) {
+	ShaderParameter const* pParameter = findShaderParameter(program, nameHash);
+	if (!pParameter) {
+		return true;
+	}
+	return pParameter->interface != GL_UNIFORM && pParameter->location == binding && pParameter->size == dataSize;
+}
+
+bool createShaderProgram3D(ShaderProgram& program, ShaderCache* pCache) {
 	CreateShaderProgramParams params;
+	params.pCache = pCache;
 	params.szVertFilePath = SHADER_PATH "shader_3d.vert";
 	params.szFragFilePath = SHADER_PATH "shader_3d.frag";
 	if (!createShaderProgram(program, params)) {
 		assert(false);
 		return false;
 	}
-
-	// Upload uniforms
-	program.LoadLocation();
 	return true;
 }
 
-void	 ShaderProgram3D_custom::LoadLocation() {
-	ShaderProgram3D::LoadLocation();
-	timeLocation = glGetUniformLocation(programId, "Time");
+bool createShaderProgram3D_custom(ShaderProgram& program, ShaderCache* pCache, char const* szDefines) {
+	CreateShaderProgramParams params;
+	params.pCache = pCache;
+	params.szDefines = szDefines;
+	params.szVertFilePath = SHADER_PATH "shader_3d_custom.vert";
+	params.szFragFilePath = SHADER_PATH "shader_3d.frag";
+	if (!createShaderProgram(program, params)) {
+		// a permutation is rebuilt once its files are fixed, its draws use the default one meanwhile
+		assert(szDefines);
+		return false;
+	}
+	return true;
 }
 
-bool createShaderProgram3D_custom(ShaderProgram3D_custom& program) {
+bool createShaderProgram3D_thickLine(ShaderProgram& program, ShaderCache* pCache) {
 	CreateShaderProgramParams params;
-	params.szVertFilePath = SHADER_PATH "shader_3d_custom.vert";
+	params.pCache = pCache;
+	params.szVertFilePath = SHADER_PATH "shader_3d_thickline.vert";
 	params.szFragFilePath = SHADER_PATH "shader_3d.frag";
 	if (!createShaderProgram(program, params)) {
 		assert(false);
 		return false;
 	}
-	// Upload uniforms
-	program.LoadLocation();
 	return true;
 }
 
-bool createShaderProgram2D(ShaderProgram2D& program) {
+bool createShaderProgram2D(ShaderProgram& program, ShaderCache* pCache) {
 	CreateShaderProgramParams params;
+	params.pCache = pCache;
 	params.szVertFilePath = SHADER_PATH "shader_2d.vert";
 	params.szFragFilePath = SHADER_PATH "shader_2d.frag";
 	if (!createShaderProgram(program, params)) {
 		assert(false);
 		return false;
 	}
+	return true;
+}
 
-	program.viewportSizeLocation = glGetUniformLocation(program.programId, "ViewportSize");
-
+bool createShaderProgram2D_sdf(ShaderProgram& program, ShaderCache* pCache) {
+	CreateShaderProgramParams params;
+	params.pCache = pCache;
+	params.szVertFilePath = SHADER_PATH "shader_2d_sdf.vert";
+	params.szFragFilePath = SHADER_PATH "shader_2d_sdf.frag";
+	if (!createShaderProgram(program, params)) {
+		assert(false);
+		return false;
+	}
 	return true;
 }
@@ -1,45 +1,142 @@
 #pragma once
 
 #include <glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// FNV-1a of a uniform or block name, the reflected parameters are looked up by hash
+constexpr uint32_t hashShaderName(char const* szName) {
+	uint32_t hash = 2166136261u;
+	while (*szName) {
+		hash ^= (unsigned char)*szName++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// an active uniform or block of a linked program, read from the program interface after the link
+struct ShaderParameter {
+	uint32_t nameHash = 0;		// uniform arrays are named "Name[0]"
+	GLenum interface = 0;		// GL_UNIFORM, GL_UNIFORM_BLOCK or GL_SHADER_STORAGE_BLOCK
+	GLenum type = 0;			// of the uniforms: GL_INT, GL_BOOL, GL_FLOAT_VEC2...
+	GLint location = -1;		// binding of the blocks
+	GLint size = 0;				// array size of the uniforms, bytes of the blocks (one element of a runtime array)
+	// last upload of the uniform, the same value is not uploaded again
+	uint32_t value[4] = {};
+	bool uploaded = false;
+};
 
 struct ShaderProgram {
-	GLuint vertShaderId;
-	GLuint fragShaderId;
+	enum {
+		MaxParameters = 12
+	};
 	GLuint programId;
+	// files and defines of the program, a rebuild reads them again: they must outlive the program
+	char const* szVertFilePath = nullptr;
+	char const* szFragFilePath = nullptr;
+	char const* szDefines = nullptr;
+	// sorted by name hash, the uniforms removed by the compiler are not in it
+	ShaderParameter parameters[MaxParameters];
+	unsigned int parameterCount = 0;
 };
 
+struct ShaderCache;
+
 struct CreateShaderProgramParams {
 	char const* szVertFilePath;
 	char const* szFragFilePath;
+	char const* szDefines = nullptr;	// optional "#define" lines, inserted after the #version line of both stages
+	ShaderCache* pCache = nullptr;		// optional, the files are read through it and the programs loaded from and stored in it
+	bool parallelCompile = false;		// KHR_parallel_shader_compile is supported
 };
 
+// on failure programId is 0 and the files and defines are kept, a rebuild can read them again
 bool createShaderProgram(ShaderProgram& program, const CreateShaderProgramParams& params);
 
-struct ShaderProgram3D : ShaderProgram {
-	GLuint modelLocation;
-	GLuint viewLocation;
-	GLuint projectionLocation;
-	GLuint lightLocation;
-	GLuint ambientLocation;
-	GLuint specularLocation;
-	GLuint specularPowLocation;
-	GLuint lightingEnabledLocation;
-
-	void	 LoadLocation();
+// A program compiled and linked without waiting for the driver.
+// With KHR_parallel_shader_compile the driver works on other threads until isShaderProgramBuildDone,
+// without it endShaderProgramBuild waits for the compilation.
+struct ShaderProgramBuild {
+	ShaderProgram program = {};		// programId is 0 when no build is pending
+	GLuint vertShaderId = 0;
+	GLuint fragShaderId = 0;
+	std::string vertSource;			// printed with the compile errors
+	std::string fragSource;
+	std::vector<std::string> vertFilePaths;	// by source string number of the #line directives, names the files in the compile errors
+	std::vector<std::string> fragFilePaths;
+	ShaderCache* pCache = nullptr;
+	uint64_t cacheKey = 0;
+	bool fromCache = false;
+	bool parallelCompile = false;
 };
 
-bool createShaderProgram3D(ShaderProgram3D& program);
+// false when a file can not be read
+bool beginShaderProgramBuild(ShaderProgramBuild& build, const CreateShaderProgramParams& params);
+bool isShaderProgramBuildDone(const ShaderProgramBuild& build);
+// build.program is the linked program on success, on failure the objects of the build are deleted
+bool endShaderProgramBuild(ShaderProgramBuild& build);
+// abandons a pending build
+void deleteShaderProgramBuild(ShaderProgramBuild& build);
 
-struct ShaderProgram3D_custom : ShaderProgram3D {
-	GLuint timeLocation;
-	void	 LoadLocation();
+// std140 layout of the FrameData uniform block of the 3D shaders
+struct FrameData3D {
+	enum {
+		Binding = 0
+	};
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 light;	// view space
+	float ambient;
+	float specular;
+	float specularPow;
+	float time;
+	float padding;
+	glm::vec2 viewportSize;	// pixels
+	glm::vec2 padding2;		// std140 rounds the size of the block up to a multiple of 16
 };
+static_assert(sizeof(FrameData3D) == 176, "FrameData3D must match the std140 layout of FrameData");
 
-bool createShaderProgram3D_custom(ShaderProgram3D_custom& program);
-
-struct ShaderProgram2D : ShaderProgram {
-	GLuint viewportSizeLocation;
+// std430 layout of an entry of the DrawData storage buffer of the 3D shaders, one per draw
+struct DrawData3D {
+	enum {
+		Binding = 1
+	};
+	glm::mat4 model;
+	glm::vec4 color;	// multiplies the vertex colors
 };
+static_assert(sizeof(DrawData3D) == 80, "DrawData3D must match the std430 layout of DrawData");
+
+// the active uniforms and blocks of a linked program, done by the builds
+void reflectShaderProgram(ShaderProgram& program);
+
+// null when the program does not use it
+ShaderParameter const* findShaderParameter(const ShaderProgram& program, uint32_t nameHash);
+
+// the uniforms the program does not use are skipped, as the values already uploaded
+// the type must be the one declared in the shader, int for bool
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, int value);
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, float value);
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, const glm::vec2& value);
+void setShaderParameter(ShaderProgram& program, uint32_t nameHash, const glm::vec4& value);
+
+// true when the program does not use the block or declares it with this binding and size
+bool checkShaderBlock(const ShaderProgram& program, uint32_t nameHash, GLint binding, GLint dataSize);
+
+bool createShaderProgram3D(ShaderProgram& program, ShaderCache* pCache = nullptr);
+
+// szDefines selects the effect of shader_3d_custom.vert (ShaderType), see RenderApi3D::customShader
+bool createShaderProgram3D_custom(ShaderProgram& program, ShaderCache* pCache = nullptr, char const* szDefines = nullptr);
+
+// screen space thick lines, one quad per segment (eStreamLayout3D::LineSegment)
+bool createShaderProgram3D_thickLine(ShaderProgram& program, ShaderCache* pCache = nullptr);
 
-bool createShaderProgram2D(ShaderProgram2D& program);
+bool createShaderProgram2D(ShaderProgram& program, ShaderCache* pCache = nullptr);
 
+// analytic 2D shapes, rasterized from a signed distance (StreamShape2D vertices)
+bool createShaderProgram2D_sdf(ShaderProgram& program, ShaderCache* pCache = nullptr);
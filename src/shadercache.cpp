@@ -0,0 +1,145 @@
+#include "shadercache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+	constexpr uint32_t CacheFileMagic = 0x42504c47;	// "GLPB"
+	constexpr uint32_t CacheFileVersion = 1;
+
+	struct CacheFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binarySize;
+	};
+
+	// FNV-1a
+	uint64_t hashBytes(uint64_t hash, void const* pData, size_t size) {
+		unsigned char const* pBytes = (unsigned char const*)pData;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= pBytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	uint64_t hashString(uint64_t hash, char const* szString) {
+		// the terminating zero separates consecutive strings
+		return hashBytes(hash, szString ? szString : "", szString ? strlen(szString) + 1 : 1);
+	}
+
+	void getCacheFilePath(const ShaderCache& cache, uint64_t key, char* szPath, size_t pathSize) {
+		snprintf(szPath, pathSize, "%s%016llx.bin", cache.directory, (unsigned long long)key);
+	}
+}
+
+bool createShaderCache(ShaderCache& cache, char const* szDirectory) {
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	cache.enabled = formatCount > 0;
+	if (!cache.enabled) {
+		fprintf(stderr, "No program binary format, shader cache disabled\n");
+		return false;
+	}
+
+	strncpy(cache.directory, szDirectory, sizeof(cache.directory) - 1);
+#ifdef _WIN32
+	_mkdir(cache.directory);
+#else
+	mkdir(cache.directory, 0755);
+#endif
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = hashString(hash, (char const*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (char const*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (char const*)glGetString(GL_VERSION));
+	cache.driverHash = hash;
+	cache.hits = 0;
+	cache.misses = 0;
+	cache.rejected = 0;
+	return true;
+}
+
+uint64_t getShaderCacheKey(const ShaderCache& cache, char const* const* sources, int sourceCount) {
+	uint64_t hash = cache.driverHash;
+	for (int iSource = 0; iSource < sourceCount; ++iSource) {
+		hash = hashString(hash, sources[iSource]);
+	}
+	return hash;
+}
+
+GLuint loadCachedProgram(ShaderCache& cache, uint64_t key) {
+	if (!cache.enabled) {
+		return 0;
+	}
+
+	char path[600];
+	getCacheFilePath(cache, key, path, sizeof(path));
+	FILE* pFile = fopen(path, "rb");
+	if (!pFile) {
+		++cache.misses;
+		return 0;
+	}
+
+	CacheFileHeader header;
+	std::vector<char> binary;
+	bool valid = fread(&header, sizeof(header), 1, pFile) == 1
+		&& header.magic == CacheFileMagic && header.version == CacheFileVersion && header.key == key;
+	if (valid) {
+		binary.resize(header.binarySize);
+		valid = fread(binary.data(), 1, binary.size(), pFile) == binary.size();
+	}
+	fclose(pFile);
+	if (!valid) {
+		++cache.misses;
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, (GLenum)header.binaryFormat, binary.data(), (GLsizei)binary.size());
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		glDeleteProgram(program);
+		++cache.rejected;
+		return 0;
+	}
+	++cache.hits;
+	return program;
+}
+
+void storeCachedProgram(ShaderCache& cache, uint64_t key, GLuint program) {
+	if (!cache.enabled) {
+		return;
+	}
+
+	GLint binarySize = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+	if (binarySize <= 0) {
+		return;
+	}
+	std::vector<char> binary(binarySize);
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(program, binarySize, &binarySize, &binaryFormat, binary.data());
+
+	char path[600];
+	getCacheFilePath(cache, key, path, sizeof(path));
+	FILE* pFile = fopen(path, "wb");
+	if (!pFile) {
+		fprintf(stderr, "Failed to write the shader cache file %s\n", path);
+		return;
+	}
+	const CacheFileHeader header = { CacheFileMagic, CacheFileVersion, key, (uint32_t)binaryFormat, (uint32_t)binarySize };
+	fwrite(&header, sizeof(header), 1, pFile);
+	fwrite(binary.data(), 1, binarySize, pFile);
+	fclose(pFile);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glad.h>
+
+#include "shadersource.h"
+
+#include <stdint.h>
+
+// Linked program binaries stored in a directory, one file per program.
+// The key hashes the sources given to the compiler with the vendor, renderer and version strings of the driver,
+// a driver update or a source change is a miss and the program is compiled and stored again.
+struct ShaderCache {
+	// the files of the sources, with their includes
+	ShaderSourceCache sources;
+
+	char directory[512] = {};
+	uint64_t driverHash = 0;
+	bool enabled = false;		// false when the driver has no program binary format
+
+	// counters since the creation
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	unsigned int rejected = 0;	// binaries refused by the driver, compiled again
+};
+
+// the directory is created when missing, szDirectory ends with a path separator
+bool createShaderCache(ShaderCache& cache, char const* szDirectory);
+
+uint64_t getShaderCacheKey(const ShaderCache& cache, char const* const* sources, int sourceCount);
+
+// linked program, 0 on a miss or when the driver rejects the binary
+GLuint loadCachedProgram(ShaderCache& cache, uint64_t key);
+
+// program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+void storeCachedProgram(ShaderCache& cache, uint64_t key, GLuint program);
@@ -0,0 +1,93 @@
+#include "shaderdatabuffer.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+namespace {
+	void markDirty(ShaderDataBuffer& data, GLsizeiptr begin, GLsizeiptr end) {
+		for (int iFrame = 0; iFrame < StreamBuffer::FrameCount; ++iFrame) {
+			if (data.dirtyEnd[iFrame] <= data.dirtyBegin[iFrame]) {
+				data.dirtyBegin[iFrame] = begin;
+				data.dirtyEnd[iFrame] = end;
+			}
+			else {
+				data.dirtyBegin[iFrame] = std::min(data.dirtyBegin[iFrame], begin);
+				data.dirtyEnd[iFrame] = std::max(data.dirtyEnd[iFrame], end);
+			}
+		}
+	}
+
+	// regions must start on a multiple of the storage buffer offset alignment
+	GLsizeiptr getRegionSize(GLsizeiptr size) {
+		GLint alignment = 256;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		GLsizeiptr regionSize = 256;
+		while (regionSize < size) {
+			regionSize *= 2;
+		}
+		return ((regionSize + alignment - 1) / alignment) * alignment;
+	}
+}
+
+void deleteShaderDataBuffer(ShaderDataBuffer& data) {
+	if (data.buffer.bufferId) {
+		deleteStreamBuffer(data.buffer);
+	}
+	data.pSource = nullptr;
+	data.size = 0;
+}
+
+void beginShaderDataFrame(ShaderDataBuffer& data, GLuint binding, void const* pSource, GLsizeiptr size, unsigned int version, GLsizeiptr dirtyOffset, GLsizeiptr dirtySize) {
+	data.uploadedSize = 0;
+	if (!pSource || size <= 0) {
+		data.pSource = nullptr;
+		return;
+	}
+
+	if (size > data.buffer.regionSize) {
+		// grow. the buffer is deleted right away, GL keeps its storage alive until the pending commands reading it finish
+		deleteStreamBuffer(data.buffer);
+		if (!createStreamBuffer(data.buffer, getRegionSize(size))) {
+			data.buffer.regionSize = 0;
+			data.pSource = nullptr;
+			return;
+		}
+		markDirty(data, 0, size);
+	}
+	else if (pSource != data.pSource || size != data.size) {
+		markDirty(data, 0, size);
+	}
+	else if (version != data.version) {
+		if (dirtySize > 0) {
+			assert(dirtyOffset >= 0 && dirtyOffset + dirtySize <= size);
+			markDirty(data, dirtyOffset, dirtyOffset + dirtySize);
+		}
+		else {
+			markDirty(data, 0, size);
+		}
+	}
+	data.pSource = pSource;
+	data.size = size;
+	data.version = version;
+
+	StreamBuffer& buffer = data.buffer;
+	beginStreamBufferFrame(buffer);
+
+	GLsizeiptr& dirtyBegin = data.dirtyBegin[buffer.frameIndex];
+	GLsizeiptr& dirtyEnd = data.dirtyEnd[buffer.frameIndex];
+	if (dirtyBegin < dirtyEnd) {
+		memcpy(buffer.pMappedMemory + buffer.regionOffset + dirtyBegin, (char const*)pSource + dirtyBegin, dirtyEnd - dirtyBegin);
+		data.uploadedSize = dirtyEnd - dirtyBegin;
+		dirtyBegin = 0;
+		dirtyEnd = 0;
+	}
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer.bufferId, buffer.regionOffset, size);
+}
+
+void endShaderDataFrame(ShaderDataBuffer& data) {
+	if (data.pSource && data.buffer.bufferId) {
+		endStreamBufferFrame(data.buffer);
+	}
+}
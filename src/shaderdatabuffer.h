@@ -0,0 +1,28 @@
+#pragma once
+
+#include "streambuffer.h"
+
+// Persistent copy of user data read by shaders as a storage buffer.
+// One copy per frame in flight: a frame only writes the bytes that changed since its copy was last written,
+// and writes nothing when the data version did not change.
+struct ShaderDataBuffer {
+	StreamBuffer buffer;
+	void const* pSource = nullptr;
+	GLsizeiptr size = 0;
+	unsigned int version = 0;
+
+	// bytes to copy into the region of each frame, empty when end <= begin
+	GLsizeiptr dirtyBegin[StreamBuffer::FrameCount] = {};
+	GLsizeiptr dirtyEnd[StreamBuffer::FrameCount] = {};
+
+	// bytes copied by the last beginShaderDataFrame
+	GLsizeiptr uploadedSize = 0;
+};
+
+void deleteShaderDataBuffer(ShaderDataBuffer& data);
+
+// dirtySize 0 means the whole data changed, the range is only read when version differs from the previous frame
+// the buffer is bound on binding when pSource is not null
+void beginShaderDataFrame(ShaderDataBuffer& data, GLuint binding, void const* pSource, GLsizeiptr size, unsigned int version, GLsizeiptr dirtyOffset, GLsizeiptr dirtySize);
+
+void endShaderDataFrame(ShaderDataBuffer& data);
@@ -0,0 +1,33 @@
+#version 410 core
+
+layout(location = 0, index = 0) out vec4 FragColor;
+
+in block
+{
+	vec4 Color;
+	vec2 Local;
+	vec4 Shape;
+} In;
+
+// signed distance to a box with rounded corners, negative inside
+float roundedBoxDistance(vec2 p, vec2 halfSize, float cornerRadius)
+{
+	vec2 q = abs(p) - halfSize + cornerRadius;
+	return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - cornerRadius;
+}
+
+void main()
+{
+	float d = roundedBoxDistance(In.Local, In.Shape.xy, In.Shape.z);
+	if (In.Shape.w > 0.0) {
+		// outline inside the edge
+		d = abs(d + 0.5 * In.Shape.w) - 0.5 * In.Shape.w;
+	}
+
+	// distances are in pixels: one pixel wide antialiasing
+	float coverage = clamp(0.5 - d, 0.0, 1.0);
+	if (coverage <= 0.0) {
+		discard;
+	}
+	FragColor = vec4(In.Color.rgb, In.Color.a * coverage);
+}
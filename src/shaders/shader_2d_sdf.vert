@@ -0,0 +1,29 @@
+#version 410 core
+
+#define BufferAttribPosition	0
+#define BufferAttribColor		1
+#define BufferAttribLocal		2
+#define BufferAttribShape		3
+
+uniform vec2 ViewportSize;
+
+layout(location = BufferAttribPosition) in vec2 Position;
+layout(location = BufferAttribColor) in vec4 Color;
+layout(location = BufferAttribLocal) in vec2 Local;		// pixels from the shape center, along the shape axes
+layout(location = BufferAttribShape) in vec4 Shape;		// half size xy, corner radius, outline thickness (0 to fill)
+
+out block
+{
+	vec4 Color;
+	vec2 Local;
+	vec4 Shape;
+} Out;
+
+void main()
+{
+	vec2 ndcPos = (Position / ViewportSize) * 2.0 - 1.0;
+	gl_Position = vec4(ndcPos, 0.0, 1.0);
+	Out.Color = Color;
+	Out.Local = Local;
+	Out.Shape = Shape;
+}
@@ -1,10 +1,6 @@
-#version 410 core
+#version 430 core
 
-
-uniform vec3 Light;
-uniform float Ambient;
-uniform float Specular;
-uniform float SpecularPow;
+#include "shader_3d_frame.glsl"
 
 uniform bool LightingEnabled;
 
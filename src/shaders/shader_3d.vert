@@ -1,31 +1,19 @@
-#version 410 core
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : enable
 
-#define BufferAttribVertex 0
-#define BufferAttribNormal 1
-#define BufferAttribColor 2
-
-uniform mat4 Model;
-uniform mat4 View;
-uniform mat4 Projection;
-
-layout(location = BufferAttribVertex) in vec3 Position;
-layout(location = BufferAttribNormal) in vec3 Normal;
-layout(location = BufferAttribColor) in vec4 Color;
-
-out block
-{
-	vec4 Color;
-	vec3 CameraSpacePosition;
-	vec3 CameraSpaceNormal;
-} Out;
+#include "shader_3d_frame.glsl"
+#include "shader_3d_draw.glsl"
+#include "shader_3d_vertex.glsl"
 
 void main()
 {
+	mat4 Model = Draws[DrawIndex].Model;
+	vec4 MaterialColor = Draws[DrawIndex].Color;
 	mat4 MV = View * Model;
-	vec4 p = vec4(Position, 1.0);
-	vec4 n = vec4(Normal, 0.0);
+	vec4 p = vec4(getLocalPosition(), 1.0);
+	vec4 n = vec4(getLocalNormal(), 0.0);
 	gl_Position = Projection * MV * p;
-	Out.Color = Color;
+	Out.Color = Color * InstanceColor * MaterialColor;
 	Out.CameraSpacePosition = vec3(MV * p);
 	Out.CameraSpaceNormal = vec3(MV * n);
 }
\ No newline at end of file
@@ -1,24 +1,25 @@
 #version 430 core
+#extension GL_ARB_shader_draw_parameters : enable
 
-// You can compil and refresh the shader at runtime using the F7 key
+// The shader is rebuilt at runtime when the file is saved, F7 rebuilds every shader
 
-#define BufferAttribVertex 0
-#define BufferAttribNormal 1
-#define BufferAttribColor 2
-#define ShaderType 1
 #define M_PI 3.14159
 
+//-- ShaderType picks the effect: 0 squash, 1 bounce, 2 wave. RenderApi3D::customShader injects it
+#ifndef ShaderType
+#define ShaderType 1
+#endif
+
 
 //-- Uniform are variable that are common to all vertices of the drawcall
-uniform mat4 Model; // Model matrix
-uniform mat4 View;  // View matrix
-uniform mat4 Projection; // Projection Matrix
-uniform float Time; // Elapsed time since the begining of the program
+//-- View, Projection, lighting and Time (elapsed time since the begining of the program) are in the FrameData block
+#include "shader_3d_frame.glsl"
 
-//-- attrinutes can change for each vertex
-layout(location = BufferAttribVertex) in vec3 Position; // Position of current vertex
-layout(location = BufferAttribNormal) in vec3 Normal;		// Normal of current vertex
-layout(location = BufferAttribColor) in vec4 Color;			// Color of current vertex
+//-- Model matrix and color of the drawcall (the color multiplies the vertex color), read from the DrawData buffer
+#include "shader_3d_draw.glsl"
+
+//-- attributes, per-instance attributes, output block and rotate()
+#include "shader_3d_vertex.glsl"
 
 
 //-- Here is the GPU counterpart of the VertexShaderAdditionalData structure
@@ -33,65 +34,65 @@ layout(std430, binding= 3) buffer bufferData
 	vec4 centerAndTime[];
 } Data;
 
-out block //define the additional output that will be received by the fragment shader
-{
-	vec4 Color;
-	vec3 CameraSpacePosition;
-	vec3 CameraSpaceNormal;
-} Out;
-
 void main()
 {
+	mat4 Model = Draws[DrawIndex].Model;
+	vec4 MaterialColor = Draws[DrawIndex].Color;
 	mat4 MV = View * Model;
+	vec3 LocalPos = getLocalPosition();
+	vec3 LocalNormal = getLocalNormal();
+	vec4 WorldPos = Model * vec4(LocalPos, 1); // primitives are unit meshes placed by the model matrix
 
 
 	#if ShaderType == 0
 		// Let's squash
 
-		Out.CameraSpacePosition = vec3(MV * vec4(Position, 1));
-		Out.CameraSpaceNormal = vec3(MV * vec4(Normal, 0.0f));
-		Out.Color = Color;
-		gl_Position = Projection * MV * Position;
+		Out.CameraSpacePosition = vec3(MV * vec4(LocalPos, 1));
+		Out.CameraSpaceNormal = vec3(MV * vec4(LocalNormal, 0.0f));
+		Out.Color = Color * InstanceColor * MaterialColor;
+		gl_Position = Projection * MV * vec4(LocalPos, 1);
 
 
 	#elif ShaderType == 1
 		//Let's bounce
 
-		vec4 NewPos = vec4(Position, 1);
+		vec4 NewPos = WorldPos;
 
 		for(int i=0; i<Data.count;i++){
 			vec3 position = {Data.centerAndTime[i].x, Data.centerAndTime[i].y, Data.centerAndTime[i].z};
 			float hitTime = Data.centerAndTime[i].w;
-			float distanceFromBounce = length(Position- position);
+			float distanceFromBounce = length(WorldPos.xyz - position);
 			float distanceRate = 1.0 - clamp( distanceFromBounce/Data.radius, 0.0f, 1.0f);
 			float timeScale = clamp((Time - hitTime) / Data.duration, 0.0, 1.0);
 			
 			NewPos.y += sin(Time  * Data.speed)  * Data.power * smoothstep(0, 1, distanceRate) * (1.0-timeScale);
 		}
 
-		Out.CameraSpacePosition = vec3(MV * NewPos);
-		Out.CameraSpaceNormal = vec3(MV * vec4(Normal, 0.0f));
-		Out.Color = Color;
-		Out.Color.g = abs(Position.y - NewPos.y);
-		gl_Position = Projection * MV * NewPos;
+		Out.CameraSpacePosition = vec3(View * NewPos);
+		Out.CameraSpaceNormal = vec3(MV * vec4(LocalNormal, 0.0f));
+		Out.Color = Color * InstanceColor * MaterialColor;
+		Out.Color.g = abs(WorldPos.y - NewPos.y);
+		gl_Position = Projection * View * NewPos;
 
 
 	#else
 		//Let's wave
 
-		float XParity = mod(3.*Position.x + Time, 2.0f);
+		float XParity = mod(3.*WorldPos.x + Time, 2.0f);
 		XParity = step(XParity, 0.2f);
-		vec4 NewPos = vec4(Position, 1);
-		NewPos.x += Data.center.x;
-		NewPos.y += XParity * 0.25 + Data.center.y;
-		NewPos.z += Data.center.z;
-
-		Out.CameraSpacePosition = vec3(MV * NewPos);
-		Out.CameraSpaceNormal = vec3(MV * vec4(Normal, 0.0f));
-		Out.Color = Color;
+		// the wave follows the first bounce center
+		vec3 Center = Data.count > 0 ? Data.centerAndTime[0].xyz : vec3(0.0);
+		vec4 NewPos = WorldPos;
+		NewPos.x += Center.x;
+		NewPos.y += XParity * 0.25 + Center.y;
+		NewPos.z += Center.z;
+
+		Out.CameraSpacePosition = vec3(View * NewPos);
+		Out.CameraSpaceNormal = vec3(MV * vec4(LocalNormal, 0.0f));
+		Out.Color = Color * InstanceColor * MaterialColor;
 		Out.Color.r = (sin(Time) + 1.0f)*0.5f;
 		//gl_position is always an output and is the resulting vertex pos that will be feeded to fragment shader
-		gl_Position = Projection * MV * NewPos;
+		gl_Position = Projection * View * NewPos;
 
 
 	#endif
@@ -0,0 +1,19 @@
+// per-draw data written by the draw list (DrawData3D in shader.h)
+// with GL_ARB_shader_draw_parameters a run of draws is one multi draw indirect, DrawDataBase is its first draw
+// the including shader enables the extension before the include
+struct DrawData
+{
+	mat4 Model;
+	vec4 Color;
+};
+layout(std430, binding = 1) readonly buffer DrawDataBuffer
+{
+	DrawData Draws[];
+};
+uniform int DrawDataBase;
+
+#ifdef GL_ARB_shader_draw_parameters
+#define DrawIndex (DrawDataBase + gl_DrawIDARB)
+#else
+#define DrawIndex DrawDataBase
+#endif
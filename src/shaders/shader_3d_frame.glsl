@@ -0,0 +1,12 @@
+// per-frame data shared by every 3D program, written once per frame (FrameData3D in shader.h)
+layout(std140, binding = 0) uniform FrameData
+{
+	mat4 View;
+	mat4 Projection;
+	vec3 Light;
+	float Ambient;
+	float Specular;
+	float SpecularPow;
+	float Time;
+	vec2 ViewportSize;
+};
@@ -0,0 +1,81 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : enable
+
+// one instance per segment: the vertex array reads vertex i and i + 1 of the strip as the segment ends
+#define BufferAttribSegmentStart 0
+#define BufferAttribSegmentEnd 1
+
+#include "shader_3d_frame.glsl"
+#include "shader_3d_draw.glsl"
+
+// xyz position, w width in pixels, negative on the separators between strips
+layout(location = BufferAttribSegmentStart) in vec4 SegmentStart;
+layout(location = BufferAttribSegmentEnd) in vec4 SegmentEnd;
+
+out block
+{
+	vec4 Color;
+	vec3 CameraSpacePosition;
+	vec3 CameraSpaceNormal;
+} Out;
+
+// x: 0 at the start and 1 at the end of the segment, y: side of the line
+const vec2 Corners[6] = vec2[6](
+	vec2(0.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+	vec2(0.0, -1.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main()
+{
+	mat4 Model = Draws[DrawIndex].Model;
+	vec4 MaterialColor = Draws[DrawIndex].Color;
+	mat4 MV = View * Model;
+
+	Out.Color = MaterialColor;
+	Out.CameraSpaceNormal = vec3(0.0, 0.0, 1.0);
+
+	if (SegmentStart.w < 0.0 || SegmentEnd.w < 0.0) {
+		// segment joining two strips: degenerate triangles
+		Out.CameraSpacePosition = vec3(0.0);
+		gl_Position = vec4(0.0);
+		return;
+	}
+
+	vec2 corner = Corners[gl_VertexID % 6];
+	vec4 cameraSpaceStart = MV * vec4(SegmentStart.xyz, 1.0);
+	vec4 cameraSpaceEnd = MV * vec4(SegmentEnd.xyz, 1.0);
+
+	// w is not positive behind the camera: the segment is clipped to the near plane before the projection
+	if (Projection[2][3] != 0.0) {
+		float nearZ = -Projection[3][2] / (Projection[2][2] - 1.0);
+		bool startBehind = cameraSpaceStart.z > nearZ;
+		bool endBehind = cameraSpaceEnd.z > nearZ;
+		if (startBehind && endBehind) {
+			Out.CameraSpacePosition = vec3(0.0);
+			gl_Position = vec4(0.0);
+			return;
+		}
+		if (startBehind || endBehind) {
+			vec4 nearPoint = mix(cameraSpaceStart, cameraSpaceEnd, (nearZ - cameraSpaceStart.z) / (cameraSpaceEnd.z - cameraSpaceStart.z));
+			cameraSpaceStart = startBehind ? nearPoint : cameraSpaceStart;
+			cameraSpaceEnd = endBehind ? nearPoint : cameraSpaceEnd;
+		}
+	}
+
+	vec4 clipStart = Projection * cameraSpaceStart;
+	vec4 clipEnd = Projection * cameraSpaceEnd;
+
+	// direction in pixels, the quad is extended by half the width on both ends to close the joints
+	vec2 halfViewport = 0.5 * ViewportSize;
+	vec2 direction = clipEnd.xy / clipEnd.w * halfViewport - clipStart.xy / clipStart.w * halfViewport;
+	direction = length(direction) > 0.0 ? normalize(direction) : vec2(1.0, 0.0);
+	vec2 normal = vec2(-direction.y, direction.x);
+
+	vec4 clip = corner.x == 0.0 ? clipStart : clipEnd;
+	float halfWidth = 0.5 * (corner.x == 0.0 ? SegmentStart.w : SegmentEnd.w);
+	vec2 offset = (normal * corner.y + direction * (corner.x * 2.0 - 1.0)) * halfWidth;
+	clip.xy += offset / halfViewport * clip.w;
+
+	Out.CameraSpacePosition = vec3(corner.x == 0.0 ? cameraSpaceStart : cameraSpaceEnd);
+	gl_Position = clip;
+}
@@ -0,0 +1,41 @@
+// vertex attributes and outputs of the programs drawing Buffer3D meshes (shader_3d.vert, shader_3d_custom.vert)
+
+#define BufferAttribVertex 0
+#define BufferAttribNormal 1
+#define BufferAttribColor 2
+#define BufferAttribInstanceRotation 3
+#define BufferAttribInstancePositionScale 4
+#define BufferAttribInstanceColor 5
+
+layout(location = BufferAttribVertex) in vec3 Position;
+layout(location = BufferAttribNormal) in vec3 Normal;
+layout(location = BufferAttribColor) in vec4 Color;
+
+// per-instance attributes of the batch draws (solidSpheres, bones...)
+// identity rotation, no offset, scale 1 and white when not instanced
+layout(location = BufferAttribInstanceRotation) in vec4 InstanceRotation;			// quaternion xyzw
+layout(location = BufferAttribInstancePositionScale) in vec4 InstancePositionScale;	// position xyz, scale w
+layout(location = BufferAttribInstanceColor) in vec4 InstanceColor;
+
+out block
+{
+	vec4 Color;
+	vec3 CameraSpacePosition;
+	vec3 CameraSpaceNormal;
+} Out;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// the vertex placed by its instance, in the space of the model matrix
+vec3 getLocalPosition()
+{
+	return rotate(InstanceRotation, Position * InstancePositionScale.w) + InstancePositionScale.xyz;
+}
+
+vec3 getLocalNormal()
+{
+	return rotate(InstanceRotation, Normal);
+}
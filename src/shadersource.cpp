@@ -0,0 +1,190 @@
+#include "shadersource.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+	constexpr int MaxIncludeDepth = 16;
+
+	int findFile(const ShaderSourceCache& cache, char const* szPath) {
+		for (size_t iFile = 0; iFile < cache.files.size(); ++iFile) {
+			if (cache.files[iFile].path == szPath) {
+				return (int)iFile;
+			}
+		}
+		return -1;
+	}
+
+	unsigned int addFile(ShaderSourceCache& cache, const std::string& path) {
+		const int iFile = findFile(cache, path.c_str());
+		if (iFile >= 0) {
+			return (unsigned int)iFile;
+		}
+		cache.files.emplace_back();
+		cache.files.back().path = path;
+		return (unsigned int)cache.files.size() - 1;
+	}
+
+	// the name of an #include "name" line, false for the other lines
+	bool parseInclude(char const* pLine, char const* pLineEnd, std::string& name) {
+		while (pLine < pLineEnd && (*pLine == ' ' || *pLine == '\t')) {
+			++pLine;
+		}
+		if (pLineEnd - pLine < 8 || strncmp(pLine, "#include", 8) != 0) {
+			return false;
+		}
+		char const* pBegin = (char const*)memchr(pLine + 8, '"', pLineEnd - pLine - 8);
+		if (!pBegin) {
+			return false;
+		}
+		char const* pEnd = (char const*)memchr(pBegin + 1, '"', pLineEnd - pBegin - 1);
+		if (!pEnd) {
+			return false;
+		}
+		name.assign(pBegin + 1, pEnd);
+		return true;
+	}
+
+	char const* getLineEnd(const std::string& text, size_t lineBegin) {
+		const size_t lineEnd = text.find('\n', lineBegin);
+		return text.c_str() + (lineEnd == std::string::npos ? text.size() : lineEnd);
+	}
+
+	// reads the file and adds its includes to the cache, files may move
+	bool loadFile(ShaderSourceCache& cache, unsigned int iFile) {
+		if (cache.files[iFile].loaded) {
+			return true;
+		}
+
+		const std::string path = cache.files[iFile].path;
+		FILE* pFile = fopen(path.c_str(), "rb");
+		if (!pFile) {
+			fprintf(stderr, "Failed to open file %s \n", path.c_str());
+			return false;
+		}
+		fseek(pFile, 0, SEEK_END);
+		const long fileSize = ftell(pFile);
+		rewind(pFile);
+		std::string text(fileSize, '\0');
+		fread(&text[0], 1, fileSize, pFile);
+		fclose(pFile);
+
+		const size_t separator = path.find_last_of("/\\");
+		const std::string directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+		std::vector<unsigned int> includes;
+		std::string name;
+		for (size_t lineBegin = 0; lineBegin < text.size(); ) {
+			char const* pLineEnd = getLineEnd(text, lineBegin);
+			if (parseInclude(text.c_str() + lineBegin, pLineEnd, name)) {
+				includes.push_back(addFile(cache, directory + name));
+			}
+			lineBegin = pLineEnd - text.c_str() + 1;
+		}
+
+		ShaderSourceCache::File& file = cache.files[iFile];
+		file.text.swap(text);
+		file.includes.swap(includes);
+		file.loaded = true;
+		return true;
+	}
+
+	void appendLineDirective(std::string& source, unsigned int line, unsigned int sourceNumber) {
+		char directive[64];
+		snprintf(directive, sizeof(directive), "#line %u %u\n", line, sourceNumber);
+		source += directive;
+	}
+
+	// the source string number of the file is its index in pastedFiles
+	bool pasteFile(ShaderSourceCache& cache, unsigned int iFile, std::string& source, std::vector<unsigned int>& pastedFiles, int depth) {
+		if (depth > MaxIncludeDepth) {
+			fprintf(stderr, "Includes too deep in %s\n", cache.files[iFile].path.c_str());
+			return false;
+		}
+		if (!loadFile(cache, iFile)) {
+			return false;
+		}
+		const unsigned int sourceNumber = (unsigned int)pastedFiles.size();
+		pastedFiles.push_back(iFile);
+
+		// the includes load other files: the file is read by index
+		std::string name;
+		unsigned int iInclude = 0;
+		unsigned int line = 1;
+		for (size_t lineBegin = 0; lineBegin < cache.files[iFile].text.size(); ++line) {
+			const std::string& text = cache.files[iFile].text;
+			char const* pLineEnd = getLineEnd(text, lineBegin);
+			const size_t lineEnd = pLineEnd - text.c_str();
+			if (parseInclude(text.c_str() + lineBegin, pLineEnd, name)) {
+				const unsigned int iIncludedFile = cache.files[iFile].includes[iInclude++];
+				bool pasted = false;
+				for (unsigned int iPastedFile : pastedFiles) {
+					pasted |= iPastedFile == iIncludedFile;
+				}
+				if (pasted) {
+					// an empty line keeps the numbering
+					source += '\n';
+				}
+				else {
+					appendLineDirective(source, 1, (unsigned int)pastedFiles.size());
+					if (!pasteFile(cache, iIncludedFile, source, pastedFiles, depth + 1)) {
+						fprintf(stderr, "Failed to include %s in %s\n", name.c_str(), cache.files[iFile].path.c_str());
+						return false;
+					}
+					appendLineDirective(source, line + 1, sourceNumber);
+				}
+			}
+			else {
+				source.append(text, lineBegin, lineEnd - lineBegin);
+				source += '\n';
+			}
+			lineBegin = lineEnd + 1;
+		}
+		return true;
+	}
+
+	bool dependsOnFile(const ShaderSourceCache& cache, unsigned int iFile, unsigned int iDependency, std::vector<bool>& visited) {
+		if (iFile == iDependency) {
+			return true;
+		}
+		visited[iFile] = true;
+		for (unsigned int iInclude : cache.files[iFile].includes) {
+			if (!visited[iInclude] && dependsOnFile(cache, iInclude, iDependency, visited)) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+bool preprocessShaderSource(ShaderSourceCache& cache, char const* szPath, std::string& source, std::vector<std::string>& filePaths) {
+	source.clear();
+	filePaths.clear();
+	std::vector<unsigned int> pastedFiles;
+	if (!pasteFile(cache, addFile(cache, szPath), source, pastedFiles, 0)) {
+		return false;
+	}
+	for (unsigned int iFile : pastedFiles) {
+		filePaths.push_back(cache.files[iFile].path);
+	}
+	return true;
+}
+
+void invalidateShaderSource(ShaderSourceCache& cache, char const* szPath) {
+	const int iFile = findFile(cache, szPath);
+	if (iFile >= 0) {
+		ShaderSourceCache::File& file = cache.files[iFile];
+		file.loaded = false;
+		file.text.clear();
+		// the includes are kept until the file is read again: its dependents are still found
+	}
+}
+
+bool dependsOnShaderFile(const ShaderSourceCache& cache, char const* szPath, char const* szDependency) {
+	const int iFile = findFile(cache, szPath);
+	const int iDependency = findFile(cache, szDependency);
+	if (iFile < 0 || iDependency < 0) {
+		return false;
+	}
+	std::vector<bool> visited(cache.files.size(), false);
+	return dependsOnFile(cache, (unsigned int)iFile, (unsigned int)iDependency, visited);
+}
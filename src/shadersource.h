@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Shader files read once and kept in memory, with the graph of their #include "file" directives.
+// An include is resolved from the directory of the file that includes it. A file is pasted once per source,
+// the next includes of it are skipped as with #pragma once. Included files have no #version line.
+// #line directives around the pasted files keep the lines of the compile errors, their source string number
+// is the index of the file in the filePaths of preprocessShaderSource.
+struct ShaderSourceCache {
+	struct File {
+		std::string path;
+		std::string text;
+		bool loaded = false;
+		std::vector<unsigned int> includes;		// indices in files, read when the file is loaded
+	};
+	std::vector<File> files;
+};
+
+// the text of the file with its includes pasted, false when a file can not be read
+// filePaths are the files by source string number, szPath is 0
+bool preprocessShaderSource(ShaderSourceCache& cache, char const* szPath, std::string& source, std::vector<std::string>& filePaths);
+
+// the next preprocessShaderSource reads the file again
+void invalidateShaderSource(ShaderSourceCache& cache, char const* szPath);
+
+// szDependency is szPath itself or one of the files it includes, directly or not
+bool dependsOnShaderFile(const ShaderSourceCache& cache, char const* szPath, char const* szDependency);
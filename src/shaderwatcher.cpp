@@ -0,0 +1,140 @@
+#include "shaderwatcher.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	void readFileStatus(ShaderWatcher::File& file) {
+		struct stat status;
+		if (stat(file.path.c_str(), &status) == 0) {
+			file.modificationTime = status.st_mtime;
+			file.size = (long long)status.st_size;
+		}
+	}
+
+	void addChangedPath(ShaderWatcher& watcher, const std::string& path) {
+		for (const std::string& changedPath : watcher.changedPaths) {
+			if (changedPath == path) {
+				return;
+			}
+		}
+		watcher.changedPaths.push_back(path);
+	}
+
+	// the files inotify does not watch
+	void pollFileStatus(ShaderWatcher& watcher) {
+		// the modification times have a resolution of a second
+		const time_t currentTime = time(nullptr);
+		if (currentTime == watcher.lastPollTime) {
+			return;
+		}
+		watcher.lastPollTime = currentTime;
+
+		for (ShaderWatcher::File& file : watcher.files) {
+			if (watcher.inotifyFd >= 0 && file.directoryWatch >= 0) {
+				continue;
+			}
+			const time_t modificationTime = file.modificationTime;
+			const long long size = file.size;
+			readFileStatus(file);
+			if (file.modificationTime != modificationTime || file.size != size) {
+				addChangedPath(watcher, file.path);
+			}
+		}
+	}
+
+#ifdef __linux__
+	void readInotifyEvents(ShaderWatcher& watcher) {
+		alignas(inotify_event) char buffer[4096];
+		for (;;) {
+			const ssize_t size = read(watcher.inotifyFd, buffer, sizeof(buffer));
+			if (size <= 0) {
+				return;
+			}
+			for (char const* pEvent = buffer; pEvent < buffer + size; ) {
+				const inotify_event& event = *(inotify_event const*)pEvent;
+				if (event.mask & IN_Q_OVERFLOW) {
+					for (const ShaderWatcher::File& file : watcher.files) {
+						addChangedPath(watcher, file.path);
+					}
+				}
+				else if (event.len) {
+					for (const ShaderWatcher::File& file : watcher.files) {
+						if (file.directoryWatch == event.wd && file.name == event.name) {
+							addChangedPath(watcher, file.path);
+						}
+					}
+				}
+				pEvent += sizeof(inotify_event) + event.len;
+			}
+		}
+	}
+#endif
+}
+
+bool createShaderWatcher(ShaderWatcher& watcher) {
+	watcher.files.clear();
+	watcher.changedPaths.clear();
+	watcher.lastPollTime = 0;
+#ifdef __linux__
+	watcher.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watcher.inotifyFd < 0) {
+		fprintf(stderr, "inotify unavailable, shader files are polled\n");
+	}
+#endif
+	return true;
+}
+
+void deleteShaderWatcher(ShaderWatcher& watcher) {
+#ifdef __linux__
+	if (watcher.inotifyFd >= 0) {
+		close(watcher.inotifyFd);
+	}
+#endif
+	watcher.inotifyFd = -1;
+	watcher.files.clear();
+	watcher.changedPaths.clear();
+}
+
+void watchShaderFile(ShaderWatcher& watcher, char const* szPath) {
+	for (const ShaderWatcher::File& file : watcher.files) {
+		if (file.path == szPath) {
+			return;
+		}
+	}
+
+	ShaderWatcher::File file;
+	file.path = szPath;
+	const size_t separator = file.path.find_last_of("/\\");
+	const std::string directory = separator == std::string::npos ? "." : file.path.substr(0, separator + 1);
+	file.name = separator == std::string::npos ? file.path : file.path.substr(separator + 1);
+	readFileStatus(file);
+#ifdef __linux__
+	if (watcher.inotifyFd >= 0) {
+		// a directory watched twice returns the same descriptor
+		file.directoryWatch = inotify_add_watch(watcher.inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (file.directoryWatch < 0) {
+			fprintf(stderr, "Failed to watch %s, %s is polled\n", directory.c_str(), file.name.c_str());
+		}
+	}
+#endif
+	watcher.files.push_back(file);
+}
+
+bool pollShaderWatcher(ShaderWatcher& watcher) {
+	watcher.changedPaths.clear();
+#ifdef __linux__
+	if (watcher.inotifyFd >= 0) {
+		readInotifyEvents(watcher);
+	}
+#endif
+	pollFileStatus(watcher);
+	return !watcher.changedPaths.empty();
+}
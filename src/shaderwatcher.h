@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <time.h>
+#include <vector>
+
+// Changes of the shader files, read once per frame without blocking.
+// On Linux the directories of the files are watched with inotify, a file counts as changed when it is closed after
+// a write or when an editor renames a new version over it. Elsewhere, and for the files whose directory can not be watched,
+// the modification times are compared once per second.
+struct ShaderWatcher {
+	struct File {
+		std::string path;
+		std::string name;			// inotify events only carry the name in the directory
+		int directoryWatch = -1;	// negative when the file is polled
+		time_t modificationTime = 0;
+		long long size = 0;
+	};
+	std::vector<File> files;
+	std::vector<std::string> changedPaths;		// of the last pollShaderWatcher
+
+	int inotifyFd = -1;
+	time_t lastPollTime = 0;
+};
+
+bool createShaderWatcher(ShaderWatcher& watcher);
+void deleteShaderWatcher(ShaderWatcher& watcher);
+
+// a file watched twice is reported once
+void watchShaderFile(ShaderWatcher& watcher, char const* szPath);
+
+// true when some watched files changed since the last call, they are in changedPaths
+bool pollShaderWatcher(ShaderWatcher& watcher);
@@ -0,0 +1,163 @@
+#include "streambuffer.h"
+#include "drawbuffer.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+
+bool createStreamBuffer(StreamBuffer& buffer, GLsizeiptr regionSize) {
+	assert(buffer.bufferId == 0); // trying to create a buffer already initialized
+
+	constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr size = regionSize * StreamBuffer::FrameCount;
+
+	glCreateBuffers(1, &buffer.bufferId);
+	glNamedBufferStorage(buffer.bufferId, size, nullptr, flags);
+	buffer.pMappedMemory = (char*)glMapNamedBufferRange(buffer.bufferId, 0, size, flags);
+
+	if (!buffer.pMappedMemory) {
+		fprintf(stderr, "Failed to map stream buffer\n");
+		deleteStreamBuffer(buffer);
+		return false;
+	}
+
+	buffer.regionSize = regionSize;
+	buffer.regionOffset = 0;
+	buffer.usedSize = 0;
+	buffer.frameIndex = 0;
+	return true;
+}
+
+void deleteStreamBuffer(StreamBuffer& buffer) {
+	for (GLsync& fence : buffer.fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	if (buffer.pMappedMemory) {
+		glUnmapNamedBuffer(buffer.bufferId);
+		buffer.pMappedMemory = nullptr;
+	}
+	glDeleteBuffers(1, &buffer.bufferId);
+	buffer.bufferId = 0;
+}
+
+void beginStreamBufferFrame(StreamBuffer& buffer) {
+	GLsync& fence = buffer.fences[buffer.frameIndex];
+	if (fence) {
+		GLenum waitResult;
+		do {
+			waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		} while (waitResult == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	buffer.regionOffset = buffer.frameIndex * buffer.regionSize;
+	buffer.usedSize = 0;
+}
+
+void endStreamBufferFrame(StreamBuffer& buffer) {
+	assert(buffer.fences[buffer.frameIndex] == nullptr); // did you call beginStreamBufferFrame ?
+	buffer.fences[buffer.frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	buffer.frameIndex = (buffer.frameIndex + 1) % StreamBuffer::FrameCount;
+}
+
+void* allocateStreamBuffer(StreamBuffer& buffer, GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset) {
+	const GLsizeiptr regionEnd = buffer.regionOffset + buffer.regionSize;
+	const GLsizeiptr current = buffer.regionOffset + buffer.usedSize;
+	const GLsizeiptr aligned = ((current + alignment - 1) / alignment) * alignment;
+	if (aligned + size > regionEnd) {
+		return nullptr;
+	}
+	buffer.usedSize = aligned + size - buffer.regionOffset;
+	offset = aligned;
+	return buffer.pMappedMemory + aligned;
+}
+
+void createStreamVertexArray3D(GLuint& vao, const StreamBuffer& buffer, eStreamLayout3D layout, GLuint defaultVertexBuffer) {
+	glCreateVertexArrays(1, &vao);
+
+	// attribute locations match BufferAttribVertex / BufferAttribNormal / BufferAttribColor in shader_3d.vert
+	if (layout == eStreamLayout3D::PositionNormalColor) {
+		glVertexArrayVertexBuffer(vao, 0, buffer.bufferId, 0, sizeof(StreamLitVertex3D));
+		glEnableVertexArrayAttrib(vao, 0);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(StreamLitVertex3D, position));
+		glVertexArrayAttribBinding(vao, 0, 0);
+		glEnableVertexArrayAttrib(vao, 1);
+		glVertexArrayAttribFormat(vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(StreamLitVertex3D, normal));
+		glVertexArrayAttribBinding(vao, 1, 0);
+		glEnableVertexArrayAttrib(vao, 2);
+		glVertexArrayAttribFormat(vao, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(StreamLitVertex3D, color));
+		glVertexArrayAttribBinding(vao, 2, 0);
+	}
+	else if (layout == eStreamLayout3D::LineSegment) {
+		// instance i reads vertices i and i + 1, draws select their first vertex with base instance
+		glVertexArrayVertexBuffer(vao, 0, buffer.bufferId, 0, sizeof(glm::vec4));
+		glVertexArrayBindingDivisor(vao, 0, 1);
+		glEnableVertexArrayAttrib(vao, 0);
+		glVertexArrayAttribFormat(vao, 0, 4, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(vao, 0, 0);
+		glEnableVertexArrayAttrib(vao, 1);
+		glVertexArrayAttribFormat(vao, 1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4));
+		glVertexArrayAttribBinding(vao, 1, 0);
+	}
+	else if (layout == eStreamLayout3D::PositionColor) {
+		glVertexArrayVertexBuffer(vao, 0, buffer.bufferId, 0, sizeof(StreamVertex3D));
+		glEnableVertexArrayAttrib(vao, 0);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(StreamVertex3D, position));
+		glVertexArrayAttribBinding(vao, 0, 0);
+		glEnableVertexArrayAttrib(vao, 2);
+		glVertexArrayAttribFormat(vao, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(StreamVertex3D, color));
+		glVertexArrayAttribBinding(vao, 2, 0);
+	}
+	else {
+		glVertexArrayVertexBuffer(vao, 0, buffer.bufferId, 0, sizeof(glm::vec3));
+		glEnableVertexArrayAttrib(vao, 0);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(vao, 0, 0);
+	}
+
+	// the line segments are drawn by their own program
+	if (layout != eStreamLayout3D::LineSegment) {
+		setDefaultVertexAttribs3D(vao, defaultVertexBuffer, layout == eStreamLayout3D::PositionNormalColor, layout != eStreamLayout3D::Position);
+	}
+
+	// indices are streamed in the same buffer
+	glVertexArrayElementBuffer(vao, buffer.bufferId);
+}
+
+void createStreamVertexArray2D(GLuint& vao, const StreamBuffer& buffer) {
+	glCreateVertexArrays(1, &vao);
+
+	// attribute locations match BufferAttribPosition / BufferAttribColor in shader_2d.vert
+	glVertexArrayVertexBuffer(vao, 0, buffer.bufferId, 0, sizeof(StreamVertex2D));
+	glEnableVertexArrayAttrib(vao, 0);
+	glVertexArrayAttribFormat(vao, 0, 2, GL_FLOAT, GL_FALSE, offsetof(StreamVertex2D, position));
+	glVertexArrayAttribBinding(vao, 0, 0);
+	glEnableVertexArrayAttrib(vao, 1);
+	glVertexArrayAttribFormat(vao, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(StreamVertex2D, color));
+	glVertexArrayAttribBinding(vao, 1, 0);
+
+	// line strip indices are streamed in the same buffer
+	glVertexArrayElementBuffer(vao, buffer.bufferId);
+}
+
+void createStreamShapeVertexArray2D(GLuint& vao, const StreamBuffer& buffer) {
+	glCreateVertexArrays(1, &vao);
+
+	// attribute locations match shader_2d_sdf.vert
+	glVertexArrayVertexBuffer(vao, 0, buffer.bufferId, 0, sizeof(StreamShape2D));
+	glEnableVertexArrayAttrib(vao, 0);
+	glVertexArrayAttribFormat(vao, 0, 2, GL_FLOAT, GL_FALSE, offsetof(StreamShape2D, position));
+	glVertexArrayAttribBinding(vao, 0, 0);
+	glEnableVertexArrayAttrib(vao, 1);
+	glVertexArrayAttribFormat(vao, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(StreamShape2D, color));
+	glVertexArrayAttribBinding(vao, 1, 0);
+	glEnableVertexArrayAttrib(vao, 2);
+	glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(StreamShape2D, local));
+	glVertexArrayAttribBinding(vao, 2, 0);
+	glEnableVertexArrayAttrib(vao, 3);
+	glVertexArrayAttribFormat(vao, 3, 4, GL_FLOAT, GL_FALSE, offsetof(StreamShape2D, shape));
+	glVertexArrayAttribBinding(vao, 3, 0);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glad.h>
+
+#include <stdint.h>
+
+// Persistently mapped buffer split in one region per frame in flight.
+// The CPU writes into the region of the current frame while the GPU reads the previous ones,
+// a fence per region makes sure a region is not overwritten while the GPU still uses it.
+struct StreamBuffer {
+	enum {
+		FrameCount = 3
+	};
+	GLuint bufferId = 0;
+	char* pMappedMemory = nullptr;
+	GLsizeiptr regionSize = 0;
+	GLsizeiptr regionOffset = 0;
+	GLsizeiptr usedSize = 0;
+	unsigned int frameIndex = 0;
+	GLsync fences[FrameCount] = {};
+};
+
+bool createStreamBuffer(StreamBuffer& buffer, GLsizeiptr regionSize);
+
+void deleteStreamBuffer(StreamBuffer& buffer);
+
+// wait until the GPU is done with the region of the frame about to be recorded
+void beginStreamBufferFrame(StreamBuffer& buffer);
+
+// fence the region of the recorded frame and move to the next one
+void endStreamBufferFrame(StreamBuffer& buffer);
+
+// returns a pointer into mapped memory and its offset in the buffer, or nullptr when the frame region is full
+// offset is a multiple of alignment (which does not need to be a power of two)
+void* allocateStreamBuffer(StreamBuffer& buffer, GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+
+// colors and normals use the packed encodings of drawbuffer.h (packVertexColor / packVertexNormal)
+struct StreamVertex3D {
+	glm::vec3 position;
+	uint32_t color;
+};
+
+struct StreamLitVertex3D {
+	glm::vec3 position;
+	uint32_t normal;
+	uint32_t color;
+};
+
+enum class eStreamLayout3D {
+	Position = 0,				// glm::vec3, the color is constant for the draw
+	PositionColor,				// StreamVertex3D
+	PositionNormalColor,		// StreamLitVertex3D
+	LineSegment,				// glm::vec4 position and width in pixels, read per instance as segment start and end
+	Count
+};
+
+// vao sourcing the whole stream buffer with the given layout, draws select their vertices with first / base vertex
+// the attributes missing from the layout read defaultVertexBuffer, see setDefaultVertexAttribs3D
+void createStreamVertexArray3D(GLuint& vao, const StreamBuffer& buffer, eStreamLayout3D layout, GLuint defaultVertexBuffer);
+
+// 2D overlay vertex, position in pixels, read by shader_2d.vert
+struct StreamVertex2D {
+	glm::vec2 position;
+	uint32_t color;
+};
+
+// vao sourcing the whole stream buffer as StreamVertex2D, draws select their vertices with first / base vertex
+void createStreamVertexArray2D(GLuint& vao, const StreamBuffer& buffer);
+
+// analytic 2D shape vertex, read by shader_2d_sdf.vert. every vertex of a shape carries the shape
+struct StreamShape2D {
+	glm::vec2 position;		// pixels
+	uint32_t color;
+	glm::vec2 local;		// pixels from the shape center, along the shape axes
+	glm::vec4 shape;		// half size xy, corner radius, outline thickness (0 to fill)
+};
+
+void createStreamShapeVertexArray2D(GLuint& vao, const StreamBuffer& buffer);
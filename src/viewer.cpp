@@ -7,11 +7,20 @@
 #include "renderengine.h"
 #include "camera.h"
 
+#include <stdio.h>
 #include <time.h>
+#include <chrono>
+#include <vector>
 
 #include <GLFW/glfw3.h>
 #include <glad.h>
 
+#ifdef VIEWER_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <glm/common.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
@@ -82,10 +91,10 @@ namespace {
 		int lockPositionX;
 		int lockPositionY;
 
-		static constexpr float GUIStates::MOUSE_PAN_SPEED = 0.001f;
-		static constexpr float GUIStates::MOUSE_ZOOM_SPEED = 0.005f;
-		static constexpr float GUIStates::MOUSE_ZOOM_SCROLL_SPEED = 10.f * GUIStates::MOUSE_ZOOM_SPEED;
-		static constexpr float GUIStates::MOUSE_TURN_SPEED = 0.005f;
+		static constexpr float MOUSE_PAN_SPEED = 0.001f;
+		static constexpr float MOUSE_ZOOM_SPEED = 0.005f;
+		static constexpr float MOUSE_ZOOM_SCROLL_SPEED = 10.f * MOUSE_ZOOM_SPEED;
+		static constexpr float MOUSE_TURN_SPEED = 0.005f;
 	};
 
 	void initGUIStates(GUIStates& guiStates) {
@@ -109,6 +118,107 @@ namespace {
 		const Viewer& viewer = *reinterpret_cast<Viewer const*>(pUserData);
 		viewer.render2D(api);
 	}
+
+	void drawGpuTimersWindow(const GpuTimers& timers, bool* pOpen) {
+		ImGui::SetNextWindowSize(ImVec2(360.f, 0.f), ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin("GPU timings", pOpen)) {
+			ImGui::End();
+			return;
+		}
+		float total = 0.f;
+		for (int iPass = 0; iPass < (int)eGpuPass::Count; ++iPass) {
+			total += timers.passTimes[iPass];
+		}
+		ImGui::Text("total: %.3f ms, dropped frames: %u", total, timers.droppedFrames);
+		for (int iPass = 0; iPass < (int)eGpuPass::Count; ++iPass) {
+			char overlay[64];
+			sprintf(overlay, "%s: %.3f ms", getGpuPassName((eGpuPass)iPass), timers.passTimes[iPass]);
+			ImGui::PushID(iPass);
+			ImGui::PlotLines("", timers.history[iPass], GpuTimers::HistorySize, timers.historyOffset, overlay, 0.f, FLT_MAX, ImVec2(-1.f, 40.f));
+			ImGui::PopID();
+		}
+		ImGui::End();
+	}
+
+	void renderViewerFrame(Viewer& viewer, RenderEngine& renderEngine, float time) {
+		RenderParams renderParams;
+		renderParams.render3DCallback = render3DCallback;
+		renderParams.pRender3DCallbackUserData = &viewer;
+
+		renderParams.render3DCustomCallback = render3DCustomCallback;
+		renderParams.pRender3DCustomCallbackUserData = &viewer;
+
+		renderParams.render2DCallback = render2DCallback;
+		renderParams.pRender2DCallbackUserData = &viewer;
+
+		renderParams.pCamera = &viewer.camera;
+
+		renderParams.backgroundColor = viewer.backgroundColor;
+
+		renderParams.pointSize = viewer.pointSize;
+		renderParams.lineWidth = viewer.lineWidth;
+		renderParams.deferred3D = viewer.deferred3D;
+		renderParams.frustumCulling3D = viewer.frustumCulling3D;
+		renderParams.analyticShapes2D = viewer.analyticShapes2D;
+
+		renderParams.lightPosition = viewer.lightPosition;
+		renderParams.lightAmbient = viewer.lightAmbient;
+		renderParams.lightSpecular = viewer.lightSpecular;
+		renderParams.lightSpecularPow = viewer.lightSpecularPow;
+
+
+		renderParams.viewportWidth = viewer.viewportWidth;
+		renderParams.viewportHeight = viewer.viewportHeight;
+
+		renderParams.time = time;
+		renderParams.pCustomVertShaderData = viewer.pCustomShaderData;
+		renderParams.CustomVertShaderDataSize = viewer.CustomShaderDataSize;
+		renderParams.customVertShaderDataVersion = viewer.customShaderDataVersion;
+		renderParams.customVertShaderDataDirtyOffset = viewer.customShaderDataDirtyOffset < 0 ? 0 : viewer.customShaderDataDirtyOffset;
+		renderParams.customVertShaderDataDirtySize = viewer.customShaderDataDirtyOffset < 0 ? 0 : viewer.customShaderDataDirtySize;
+
+		renderEngineFrame(renderEngine, renderParams);
+		viewer.renderStats = renderEngine.stats;
+		viewer.customShaderDataDirtyOffset = 0;
+		viewer.customShaderDataDirtySize = 0;
+	}
+
+	void printFrameCaptureStats(const FrameCapture& capture) {
+		printf("%u frames captured, %u dropped\n", capture.writtenFrames.load(), capture.droppedFrames);
+	}
+
+	// starts and stops the capture with Viewer::captureFrames.
+	// a stopped capture writes its frames in flight during the next frames, the render thread does not wait for them
+	void updateFrameCapture(Viewer& viewer, FrameCapture& capture, bool& capturing) {
+		if (viewer.captureFrames != capturing) {
+			if (viewer.captureFrames) {
+				// restarted before the previous capture is finished: that one waits
+				if (capture.stopping) {
+					deleteFrameCapture(capture);
+					printFrameCaptureStats(capture);
+				}
+				createFrameCapture(capture, viewer.capturePathPrefix, viewer.captureFormat);
+			}
+			else {
+				stopFrameCapture(capture);
+			}
+			capturing = viewer.captureFrames;
+		}
+		if (capturing) {
+			captureFrame(capture, viewer.viewportWidth, viewer.viewportHeight);
+		}
+		else if (capture.stopping && finishFrameCapture(capture)) {
+			printFrameCaptureStats(capture);
+		}
+	}
+
+	// at exit the frames in flight are waited for
+	void endFrameCapture(FrameCapture& capture) {
+		if (capture.worker.joinable()) {
+			deleteFrameCapture(capture);
+			printFrameCaptureStats(capture);
+		}
+	}
 }
 
 Viewer::Viewer(char const* initialWindowName, int initialViewportWidth, int initialViewportHeight) {
@@ -117,6 +227,18 @@ Viewer::Viewer(char const* initialWindowName, int initialViewportWidth, int init
 
 	pointSize = 1.f;
 	lineWidth = 1.f;
+	deferred3D = true;
+	frustumCulling3D = true;
+	analyticShapes2D = true;
+	showGpuTimers = true;
+
+	headless = false;
+	headlessFrameCount = 100;
+	headlessOutputPath[0] = '\0';
+
+	captureFrames = false;
+	strcpy(capturePathPrefix, "capture");
+	captureFormat = eCaptureFormat::PPM;
 	backgroundColor = glm::vec4(0.1f, 0.1f, 0.1f, 1.f);
 
 	lightPosition = glm::vec4(1.f, 10.f, 1.f, 1.f);
@@ -132,6 +254,31 @@ Viewer::Viewer(char const* initialWindowName, int initialViewportWidth, int init
 
 	pCustomShaderData = nullptr;
 	CustomShaderDataSize = 0;
+	customShaderDataVersion = 0;
+	customShaderDataDirtyOffset = 0;
+	customShaderDataDirtySize = 0;
+
+	api3D.pRenderEngine = nullptr;
+	api3D.pShader3D = nullptr;
+}
+
+void Viewer::markCustomShaderDataDirty(int byteOffset, int byteSize) {
+	const bool wholeData = byteSize <= 0 || (customShaderDataDirtySize == 0 && customShaderDataDirtyOffset < 0);
+	++customShaderDataVersion;
+	if (wholeData) {
+		// a negative offset marks the whole data until the next frame
+		customShaderDataDirtyOffset = -1;
+		customShaderDataDirtySize = 0;
+	}
+	else if (customShaderDataDirtySize == 0) {
+		customShaderDataDirtyOffset = byteOffset;
+		customShaderDataDirtySize = byteSize;
+	}
+	else {
+		const int dirtyEnd = glm::max(customShaderDataDirtyOffset + customShaderDataDirtySize, byteOffset + byteSize);
+		customShaderDataDirtyOffset = glm::min(customShaderDataDirtyOffset, byteOffset);
+		customShaderDataDirtySize = dirtyEnd - customShaderDataDirtyOffset;
+	}
 }
 
 namespace {
@@ -140,9 +287,205 @@ namespace {
 		assert(pViewer);
 		cameraZoom(pViewer->camera, float(-yoffset) * GUIStates::MOUSE_ZOOM_SCROLL_SPEED);
 	}
+
+	// OpenGL 4.5 core context without anything on screen
+	struct HeadlessContext {
+		GLFWwindow* window = nullptr;
+#ifdef VIEWER_EGL
+		EGLDisplay display = EGL_NO_DISPLAY;
+		EGLContext context = EGL_NO_CONTEXT;
+#endif
+	};
+
+#ifdef VIEWER_EGL
+	// surfaceless Mesa display when available (no X server nor GPU needed with llvmpipe), the default display otherwise
+	bool createHeadlessContext(HeadlessContext& context) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (eglGetPlatformDisplayEXT) {
+			context.display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+		if (context.display == EGL_NO_DISPLAY) {
+			context.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+		if (context.display == EGL_NO_DISPLAY || !eglInitialize(context.display, nullptr, nullptr)) {
+			fprintf(stderr, "Failed to initialize the EGL display\n");
+			return false;
+		}
+
+		// the default surface type is window, there is none
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(context.display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+			fprintf(stderr, "No EGL config for OpenGL\n");
+			return false;
+		}
+
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, 5,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+			EGL_NONE
+		};
+		context.context = eglCreateContext(context.display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (context.context == EGL_NO_CONTEXT || !eglMakeCurrent(context.display, EGL_NO_SURFACE, EGL_NO_SURFACE, context.context)) {
+			fprintf(stderr, "Failed to create a surfaceless OpenGL 4.5 EGL context\n");
+			return false;
+		}
+		return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+	}
+
+	void deleteHeadlessContext(HeadlessContext& context) {
+		if (context.display != EGL_NO_DISPLAY) {
+			eglMakeCurrent(context.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (context.context != EGL_NO_CONTEXT) {
+				eglDestroyContext(context.display, context.context);
+			}
+			eglTerminate(context.display);
+		}
+		context = HeadlessContext();
+	}
+#else
+	// hidden window, a display is still needed (Xvfb on a build box)
+	bool createHeadlessContext(HeadlessContext& context) {
+		if (!glfwInit()) {
+			fprintf(stderr, "Failed to init glfw\n");
+			return false;
+		}
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+		context.window = glfwCreateWindow(1, 1, "headless", NULL, NULL);
+		if (!context.window) {
+			fprintf(stderr, "Failed to create the hidden window\n");
+			glfwTerminate();
+			return false;
+		}
+		glfwMakeContextCurrent(context.window);
+		return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) != 0;
+	}
+
+	void deleteHeadlessContext(HeadlessContext& context) {
+		if (context.window) {
+			glfwDestroyWindow(context.window);
+			glfwTerminate();
+		}
+		context = HeadlessContext();
+	}
+#endif
+
+	// binary PPM, rows from the top
+	bool writeFramebufferPPM(char const* szPath, int width, int height) {
+		std::vector<unsigned char> pixels(size_t(width) * height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+		FILE* pFile = fopen(szPath, "wb");
+		if (!pFile) {
+			fprintf(stderr, "Failed to open %s\n", szPath);
+			return false;
+		}
+		fprintf(pFile, "P6\n%d %d\n255\n", width, height);
+		for (int y = height - 1; y >= 0; --y) {
+			fwrite(pixels.data() + size_t(y) * width * 3, 1, size_t(width) * 3, pFile);
+		}
+		fclose(pFile);
+		return true;
+	}
+
+	int /*exit code*/ runHeadless(Viewer& viewer) {
+		HeadlessContext context;
+		if (!createHeadlessContext(context)) {
+			deleteHeadlessContext(context);
+			return -1;
+		}
+		viewer.window = context.window;
+
+		glEnable(GL_DEBUG_OUTPUT);
+		glDebugMessageCallback(MessageCallback, 0);
+
+		// the default framebuffer of the hidden window or surfaceless context can't be read, draws go to this one
+		const int width = viewer.viewportWidth;
+		const int height = viewer.viewportHeight;
+		GLuint renderbuffers[2];
+		glCreateRenderbuffers(2, renderbuffers);
+		glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width, height);
+		glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH24_STENCIL8, width, height);
+		GLuint framebuffer;
+		glCreateFramebuffers(1, &framebuffer);
+		glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			fprintf(stderr, "Offscreen framebuffer is incomplete\n");
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(2, renderbuffers);
+			deleteHeadlessContext(context);
+			return -1;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+		int exitCode = 0;
+		RenderEngine renderEngine;
+		if (createRenderEngine(renderEngine)) {
+			viewer.api3D.pRenderEngine = &renderEngine;
+			viewer.api3D.pShader3D = &renderEngine.shader3D;
+			viewer.init();
+
+			FrameCapture capture;
+			bool capturing = false;
+
+			// fixed time step so that runs are reproducible
+			const double frameTime = 1.0 / 60.0;
+			const auto startTime = std::chrono::steady_clock::now();
+			for (int iFrame = 0; iFrame < viewer.headlessFrameCount; ++iFrame) {
+				const double time = iFrame * frameTime;
+				viewer.update(time);
+				renderViewerFrame(viewer, renderEngine, (float)time);
+				updateFrameCapture(viewer, capture, capturing);
+			}
+			glFinish();
+			const double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+			endFrameCapture(capture);
+
+			printf("%d frames, %.3f ms per frame\n", viewer.headlessFrameCount, viewer.headlessFrameCount > 0 ? elapsedMs / viewer.headlessFrameCount : 0.0);
+			for (int iPass = 0; iPass < (int)eGpuPass::Count; ++iPass) {
+				printf("  %s: %.3f ms\n", getGpuPassName((eGpuPass)iPass), viewer.renderStats.gpuPassTimes[iPass]);
+			}
+
+			if (viewer.headlessOutputPath[0] && !writeFramebufferPPM(viewer.headlessOutputPath, width, height)) {
+				exitCode = -1;
+			}
+
+			viewer.api3D.pRenderEngine = nullptr;
+			viewer.api3D.pShader3D = nullptr;
+			deleteRenderEngine(renderEngine);
+		}
+		else {
+			fprintf(stderr, "Failed to create render engine\n");
+			exitCode = -1;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(2, renderbuffers);
+		viewer.window = nullptr;
+		deleteHeadlessContext(context);
+		return exitCode;
+	}
 }
 
 int /*exit code*/ Viewer::run() {
+	if (headless) {
+		return runHeadless(*this);
+	}
 
 	// Initialize glfw library
 	if (!glfwInit()) {
@@ -225,6 +568,8 @@ int /*exit code*/ Viewer::run() {
 	if (!createRenderEngine(renderEngine)) {
 		ERROR("Failed to create render engine");
 	}
+	api3D.pRenderEngine = &renderEngine;
+	api3D.pShader3D = &renderEngine.shader3D;
 
 	// call virtual method
 	init();
@@ -233,6 +578,11 @@ int /*exit code*/ Viewer::run() {
 		ERROR("OpenGL Error before launching main loop");
 	}
 
+	FrameCapture frameCapture;
+	bool capturing = false;
+	bool f7WasPressed = false;
+	bool f8WasPressed = false;
+
 	const clock_t startTime = clock();
 
 	// Loop until the user closes the window
@@ -274,6 +624,7 @@ int /*exit code*/ Viewer::run() {
 		int leftAltPressed = glfwGetKey(window, GLFW_KEY_LEFT_ALT);
 		int rightAltPressed = glfwGetKey(window, GLFW_KEY_RIGHT_ALT);
 		int f7Pressed = glfwGetKey(window, GLFW_KEY_F7);
+		int f8Pressed = glfwGetKey(window, GLFW_KEY_F8);
 
 		const bool altPressed = leftAltPressed == GLFW_PRESS || rightAltPressed == GLFW_PRESS;
 
@@ -309,45 +660,22 @@ int /*exit code*/ Viewer::run() {
 			guiStates.lockPositionY = mousey;
 		}
 
-		if (f7Pressed) {
+		// F7 rebuilds every program, the edited shader files are rebuilt without it
+		if (f7Pressed == GLFW_PRESS && !f7WasPressed) {
 			reloadRenderEngineShaders(renderEngine);
 		}
+		f7WasPressed = f7Pressed == GLFW_PRESS;
+		updateRenderEngineShaders(renderEngine);
+		if (f8Pressed == GLFW_PRESS && !f8WasPressed) {
+			captureFrames = !captureFrames;
+		}
+		f8WasPressed = f8Pressed == GLFW_PRESS;
 
 		const clock_t currentTime = clock();
 		const double elapsedTime = (currentTime - startTime) / double(CLOCKS_PER_SEC);
 		update(elapsedTime);
 
-		RenderParams renderParams;
-		renderParams.render3DCallback = render3DCallback;
-		renderParams.pRender3DCallbackUserData = this;
-
-		renderParams.render3DCustomCallback = render3DCustomCallback;
-		renderParams.pRender3DCustomCallbackUserData = this;
-
-		renderParams.render2DCallback = render2DCallback;
-		renderParams.pRender2DCallbackUserData = this;
-
-		renderParams.pCamera = &camera;
-
-		renderParams.backgroundColor = backgroundColor;
-
-		renderParams.pointSize = pointSize;
-		renderParams.lineWidth = lineWidth;
-
-		renderParams.lightPosition = lightPosition;
-		renderParams.lightAmbient = lightAmbient;
-		renderParams.lightSpecular = lightSpecular;
-		renderParams.lightSpecularPow = lightSpecularPow;
-
-
-		renderParams.viewportWidth = viewportWidth;
-		renderParams.viewportHeight = viewportHeight;
-
-		renderParams.time = (float)t;
-		renderParams.pCustomVertShaderData = pCustomShaderData;
-		renderParams.CustomVertShaderDataSize = CustomShaderDataSize;
-
-		renderEngineFrame(renderEngine, renderParams);
+		renderViewerFrame(*this, renderEngine, (float)t);
 
 		// Start the Dear ImGui frame
 		ImGui_ImplOpenGL3_NewFrame();
@@ -355,12 +683,19 @@ int /*exit code*/ Viewer::run() {
 		ImGui::NewFrame();
 
 		drawGUI();
+		if (showGpuTimers) {
+			drawGpuTimersWindow(renderEngine.gpuTimers, &showGpuTimers);
+		}
 
 		// Rendering
 		ImGui::Render();
 		glViewport(0, 0, viewportWidth, viewportHeight);
 		//glClear(GL_COLOR_BUFFER_BIT);
+		beginGpuPass(renderEngine.gpuTimers, eGpuPass::ImGui);
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		endGpuPass(renderEngine.gpuTimers, eGpuPass::ImGui);
+
+		updateFrameCapture(*this, frameCapture, capturing);
 
 		// Swap front and back buffers
 		glfwSwapBuffers(window);
@@ -373,11 +708,21 @@ int /*exit code*/ Viewer::run() {
 		fps = 1.0 / (newTime - t);
 
 		char windowNameEx[COUNTOF(windowName) * 2];
-		sprintf(windowNameEx, "%s - %.0f fps", windowName, fps);
+		if (capturing) {
+			sprintf(windowNameEx, "%s - %.0f fps - capturing %u frames, %u dropped", windowName, fps, frameCapture.capturedFrames, frameCapture.droppedFrames);
+		}
+		else {
+			sprintf(windowNameEx, "%s - %.0f fps", windowName, fps);
+		}
 		glfwSetWindowTitle(window, windowNameEx);
 	}
 
 	// Cleanup
+	endFrameCapture(frameCapture);
+	api3D.pRenderEngine = nullptr;
+	api3D.pShader3D = nullptr;
+	deleteRenderEngine(renderEngine);
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -1,10 +1,11 @@
 #pragma once
 
 #include "camera.h"
+#include "renderapi.h"
+#include "renderengine.h"
+#include "framecapture.h"
 #include <glm/vec4.hpp>
 
-struct RenderApi3D;
-struct RenderApi2D;
 struct GLFWwindow;
 
 struct Viewer {
@@ -16,6 +17,11 @@ struct Viewer {
 	float pointSize;
 	float lineWidth;
 
+	bool deferred3D;
+	bool frustumCulling3D;
+	bool analyticShapes2D;
+	bool showGpuTimers;		// window with the GPU time of each pass
+
 	glm::vec4 backgroundColor;
 
 	glm::vec4 lightPosition;
@@ -26,14 +32,38 @@ struct Viewer {
 	int viewportWidth;
 	int viewportHeight;
 
+	// headless mode: headlessFrameCount frames rendered in an offscreen framebuffer, without events nor GUI,
+	// the time steps by 1/60 s per frame. window is null when the context is a surfaceless EGL one (VIEWER_EGL)
+	bool headless;
+	int headlessFrameCount;
+	char headlessOutputPath[512];	// last frame written as a binary PPM, nothing when empty
+
+	// every frame is written to <capturePathPrefix>_<frame number> while set, F8 toggles it
+	bool captureFrames;
+	char capturePathPrefix[512];
+	eCaptureFormat captureFormat;
+
 	void* pCustomShaderData;
 	int CustomShaderDataSize;
+	// bumped by markCustomShaderDataDirty, the data is uploaded again only when it changes
+	unsigned int customShaderDataVersion;
+	int customShaderDataDirtyOffset;
+	int customShaderDataDirtySize;
+
+	// valid from init() until the end of run(), to create and update retained meshes
+	RenderApi3D api3D;
+
+	// counters of the last rendered frame
+	RenderStats renderStats;
 
 
 	Viewer(char const* initialWindowName, int initialViewportWidth, int initialViewportHeight);
 
 	int /*exit code*/ run();
 
+	// call after modifying pCustomShaderData, byteSize 0 for the whole data
+	void markCustomShaderDataDirty(int byteOffset = 0, int byteSize = 0);
+
 	// -----------------------------------
 	// override the following functions
 	// to create your own viewer